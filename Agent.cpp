@@ -5,9 +5,6 @@
 #include <stdio.h>
 #include <iostream>
 #include <string>
-#include "DWRAONBrain.h"
-#include "MLPBrain.h"
-#include "AssemblyBrain.h"
 
 using namespace std;
 Agent::Agent()
@@ -39,6 +36,7 @@ Agent::Agent()
     repcounter= herbivore*randf(conf::REPRATEH-0.1,conf::REPRATEH+0.1) + (1-herbivore)*randf(conf::REPRATEC-0.1,conf::REPRATEC+0.1);
 
     id=0;
+    brainslot=-1;
     
     smellmod= randf(0.1, 0.5);
     soundmod= randf(0.2, 0.6);
@@ -65,9 +63,44 @@ Agent::Agent()
 void Agent::printSelf()
 {
     printf("Agent age=%i\n", age);
-    for (int i=0;i<mutations.size();i++) {
-        cout << mutations[i];
+    mutations.print();
+}
+
+AgentMemory::AgentMemory() :
+        brain(0),
+        arena(0),
+        sensors(0),
+        mutations(0),
+        traits(0),
+        overhead(0)
+{
+}
+
+size_t AgentMemory::total() const
+{
+    return brain+arena+sensors+mutations+traits+overhead;
+}
+
+AgentMemory Agent::memoryUsage() const
+{
+    AgentMemory m;
+
+    size_t payload=0, chunks=0;
+    brain.memoryUsage(payload, chunks);
+    m.brain= sizeof(brain) + payload;
+    m.overhead+= chunks-payload;
+
+    const vector<float>* sensors[4]= {&in, &out, &eyefov, &eyedir};
+    m.sensors= 4*sizeof(vector<float>);
+    for (int i=0;i<4;i++) {
+        size_t b= sensors[i]->capacity()*sizeof(float);
+        m.sensors+= b;
+        m.overhead+= heapChunk(b)-b;
     }
+
+    m.mutations= sizeof(mutations);
+    m.traits= sizeof(Agent) - sizeof(brain) - 4*sizeof(vector<float>) - sizeof(mutations);
+    return m;
 }
 
 void Agent::initEvent(float size, float r, float g, float b)
@@ -104,34 +137,44 @@ Agent Agent::reproduce(float MR, float MR2)
     //noisy attribute passing
     a2.MUTRATE1= this->MUTRATE1;
     a2.MUTRATE2= this->MUTRATE2;
-    if (randf(0,1)<0.1) a2.MUTRATE1= randn(this->MUTRATE1, conf::METAMUTRATE1);
-    if (randf(0,1)<0.1) a2.MUTRATE2= randn(this->MUTRATE2, conf::METAMUTRATE2);
+    if (randf(0,1)<0.1) {a2.MUTRATE1= randn(this->MUTRATE1, conf::METAMUTRATE1); a2.mutations.record(Mutation::MUTRATE1, 0, 0, this->MUTRATE1, a2.MUTRATE1);}
+    if (randf(0,1)<0.1) {a2.MUTRATE2= randn(this->MUTRATE2, conf::METAMUTRATE2); a2.mutations.record(Mutation::MUTRATE2, 0, 0, this->MUTRATE2, a2.MUTRATE2);}
     if (this->MUTRATE1<0.001) this->MUTRATE1= 0.001;
     if (this->MUTRATE2<0.02) this->MUTRATE2= 0.02;
     a2.herbivore= cap(randn(this->herbivore, 0.03));
-    if (randf(0,1)<MR*5) a2.clockf1= randn(a2.clockf1, MR2);
-    if (a2.clockf1<2) a2.clockf1= 2;
-    if (randf(0,1)<MR*5) a2.clockf2= randn(a2.clockf2, MR2);
-    if (a2.clockf2<2) a2.clockf2= 2;
-    
     a2.smellmod = this->smellmod;
     a2.soundmod = this->soundmod;
     a2.hearmod = this->hearmod;
     a2.eyesensmod = this->eyesensmod;
     a2.bloodmod = this->bloodmod;
-    if(randf(0,1)<MR*5) {float oo = a2.smellmod; a2.smellmod = randn(a2.smellmod, MR2); if(BDEBUG) printf("smell mutated from %f to %f\n", oo, a2.smellmod);}
-    if(randf(0,1)<MR*5) {float oo = a2.soundmod; a2.soundmod = randn(a2.soundmod, MR2); if(BDEBUG) printf("sound mutated from %f to %f\n", oo, a2.soundmod);}
-    if(randf(0,1)<MR*5) {float oo = a2.hearmod; a2.hearmod = randn(a2.hearmod, MR2); if(BDEBUG) printf("hear mutated from %f to %f\n", oo, a2.hearmod);}
-    if(randf(0,1)<MR*5) {float oo = a2.eyesensmod; a2.eyesensmod = randn(a2.eyesensmod, MR2); if(BDEBUG) printf("eyesens mutated from %f to %f\n", oo, a2.eyesensmod);}
-    if(randf(0,1)<MR*5) {float oo = a2.bloodmod; a2.bloodmod = randn(a2.bloodmod, MR2); if(BDEBUG) printf("blood mutated from %f to %f\n", oo, a2.bloodmod);}
-    
     a2.eyefov = this->eyefov;
     a2.eyedir = this->eyedir;
+
+    //traits that each mutate with probability MR*5. Only visit the ones that do
+    struct Trait { float* v; Mutation::Kind kind; int index; };
+    Trait traits[7+2*NUMEYES]= {
+        {&a2.clockf1, Mutation::CLOCK1, 0}, {&a2.clockf2, Mutation::CLOCK2, 0},
+        {&a2.smellmod, Mutation::SMELL, 0}, {&a2.soundmod, Mutation::SOUND, 0}, {&a2.hearmod, Mutation::HEAR, 0},
+        {&a2.eyesensmod, Mutation::EYESENS, 0}, {&a2.bloodmod, Mutation::BLOOD, 0},
+    };
+    for(int i=0;i<NUMEYES;i++){
+        Trait fov= {&a2.eyefov[i], Mutation::EYEFOV, i};
+        Trait dir= {&a2.eyedir[i], Mutation::EYEDIR, i};
+        traits[7+2*i]= fov;
+        traits[8+2*i]= dir;
+    }
+    const int ntraits= sizeof(traits)/sizeof(traits[0]);
+    for (int t=randskip(MR*5); t<ntraits; t+= 1+randskip(MR*5)) {
+        float oo= *traits[t].v;
+        *traits[t].v= randn(oo, MR2);
+        a2.mutations.record(traits[t].kind, traits[t].index, 0, oo, *traits[t].v);
+        if(BDEBUG) printf("trait %i mutated from %f to %f\n", t, oo, *traits[t].v);
+    }
+
+    if (a2.clockf1<2) a2.clockf1= 2;
+    if (a2.clockf2<2) a2.clockf2= 2;
     for(int i=0;i<NUMEYES;i++){
-        if(randf(0,1)<MR*5) a2.eyefov[i] = randn(a2.eyefov[i], MR2);
         if(a2.eyefov[i]<0) a2.eyefov[i] = 0;
-        
-        if(randf(0,1)<MR*5) a2.eyedir[i] = randn(a2.eyedir[i], MR2);
         if(a2.eyedir[i]<0) a2.eyedir[i] = 0;
         if(a2.eyedir[i]>2*M_PI) a2.eyedir[i] = 2*M_PI;
     }
@@ -141,7 +184,7 @@ Agent Agent::reproduce(float MR, float MR2)
     
     //mutate brain here
     a2.brain= this->brain;
-    a2.brain.mutate(MR,MR2);
+    a2.brain.mutate(MR,MR2, &a2.mutations);
     
     return a2;
 
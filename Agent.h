@@ -1,26 +1,45 @@
 #ifndef AGENT_H
 #define AGENT_H
 
-#include "DWRAONBrain.h"
-#include "AssemblyBrain.h"
-#include "MLPBrain.h"
+#include "AgentBrain.h"
+#include "MutationLog.h"
 #include "vmath.h"
 
 #include <vector>
-#include <string>
+
+/**
+ * Where the bytes of one agent go. Heap blocks are counted at the size
+ * malloc really gives out, the difference shows up as overhead
+ */
+struct AgentMemory {
+    AgentMemory();
+
+    size_t brain; //brain object and the heap blocks it owns
+    size_t arena; //its running copy in World's BrainArena
+    size_t sensors; //in, out, eyefov and eyedir
+    size_t mutations; //mutation log
+    size_t traits; //everything else kept inside the Agent
+    size_t overhead; //malloc headers and rounding of all heap blocks
+
+    size_t total() const;
+};
 
 class Agent
 {
 
 public:
     Agent();
-    
+    Agent(const Agent &other) = default;
+    Agent(Agent &&other) noexcept = default; //noexcept so agents[] moves rather than copies on growth
+    Agent& operator=(const Agent &other) = default;
+    Agent& operator=(Agent &&other) noexcept = default;
     
     void printSelf();
      //for drawing purposes
     void initEvent(float size, float r, float g, float b);
     
     void tick();
+    AgentMemory memoryUsage() const; //arena is left for World to fill in
     Agent reproduce(float MR, float MR2);
     Agent crossover(const Agent &other);
     
@@ -60,6 +79,7 @@ public:
     float give;    //is this agent attempting to give food to other agent?
 
     int id; 
+    int brainslot; //where World's BrainArena keeps the running copy of an MLP brain. -1 if none
 
     //inhereted stuff
     float herbivore; //is this agent a herbivore? between 0 and 1
@@ -76,13 +96,11 @@ public:
     std::vector<float> eyefov; //field of view for each eye
     std::vector<float> eyedir; //direction of each eye
     
-//    DWRAONBrain brain; //THE BRAIN!!!!
-//    AssemblyBrain brain;
-    MLPBrain brain;
+    AgentBrain brain; //THE BRAIN!!!! of any type
     
     //will store the mutations that this agent has from its parent
     //can be used to tune the mutation rate
-    std::vector<std::string> mutations;
+    MutationLog mutations;
 };
 
 #endif // AGENT_H
@@ -0,0 +1,239 @@
+#include "AgentBrain.h"
+
+#include <new>
+#include <string.h>
+using namespace std;
+
+static int DEFAULTTYPE= AgentBrain::MLP;
+static const char* NAMES[AgentBrain::TYPES]= {"mlp", "dwraon", "assembly", "dense"};
+
+void AgentBrain::construct(int type)
+{
+    t= type;
+    switch (t) {
+    case DWRAON: new (&d) DWRAONBrain(); break;
+    case ASSEMBLY: new (&a) AssemblyBrain(); break;
+    case DENSE: new (&n) DenseBrain(); break;
+    default: new (&m) MLPBrain();
+    }
+}
+
+void AgentBrain::destroy()
+{
+    switch (t) {
+    case DWRAON: d.~DWRAONBrain(); break;
+    case ASSEMBLY: a.~AssemblyBrain(); break;
+    case DENSE: n.~DenseBrain(); break;
+    default: m.~MLPBrain();
+    }
+}
+
+AgentBrain::AgentBrain()
+{
+    construct(DEFAULTTYPE==MIXED ? randi(0, TYPES) : DEFAULTTYPE);
+}
+
+AgentBrain::AgentBrain(int type)
+{
+    construct(type);
+}
+
+AgentBrain::AgentBrain(MLPBrain&& b) :
+        t(MLP)
+{
+    new (&m) MLPBrain(std::move(b));
+}
+
+AgentBrain::AgentBrain(DWRAONBrain&& b) :
+        t(DWRAON)
+{
+    new (&d) DWRAONBrain(std::move(b));
+}
+
+AgentBrain::AgentBrain(AssemblyBrain&& b) :
+        t(ASSEMBLY)
+{
+    new (&a) AssemblyBrain(std::move(b));
+}
+
+AgentBrain::AgentBrain(DenseBrain&& b) :
+        t(DENSE)
+{
+    new (&n) DenseBrain(std::move(b));
+}
+
+AgentBrain::AgentBrain(const AgentBrain& other) :
+        t(other.t)
+{
+    switch (t) {
+    case DWRAON: new (&d) DWRAONBrain(other.d); break;
+    case ASSEMBLY: new (&a) AssemblyBrain(other.a); break;
+    case DENSE: new (&n) DenseBrain(other.n); break;
+    default: new (&m) MLPBrain(other.m);
+    }
+}
+
+AgentBrain::AgentBrain(AgentBrain&& other) noexcept :
+        t(other.t)
+{
+    switch (t) {
+    case DWRAON: new (&d) DWRAONBrain(std::move(other.d)); break;
+    case ASSEMBLY: new (&a) AssemblyBrain(std::move(other.a)); break;
+    case DENSE: new (&n) DenseBrain(std::move(other.n)); break;
+    default: new (&m) MLPBrain(std::move(other.m));
+    }
+}
+
+AgentBrain::~AgentBrain()
+{
+    destroy();
+}
+
+AgentBrain& AgentBrain::operator=(const AgentBrain& other)
+{
+    if (this==&other) return *this;
+    if (t==other.t) {
+        switch (t) {
+        case DWRAON: d= other.d; break;
+        case ASSEMBLY: a= other.a; break;
+        case DENSE: n= other.n; break;
+        default: m= other.m;
+        }
+    } else {
+        destroy();
+        new (this) AgentBrain(other);
+    }
+    return *this;
+}
+
+AgentBrain& AgentBrain::operator=(AgentBrain&& other) noexcept
+{
+    if (this==&other) return *this;
+    if (t==other.t) {
+        switch (t) {
+        case DWRAON: d= std::move(other.d); break;
+        case ASSEMBLY: a= std::move(other.a); break;
+        case DENSE: n= std::move(other.n); break;
+        default: m= std::move(other.m);
+        }
+    } else {
+        destroy();
+        new (this) AgentBrain(std::move(other));
+    }
+    return *this;
+}
+
+int AgentBrain::type() const
+{
+    return t;
+}
+
+MLPBrain& AgentBrain::mlp() { return m; }
+const MLPBrain& AgentBrain::mlp() const { return m; }
+DWRAONBrain& AgentBrain::dwraon() { return d; }
+const DWRAONBrain& AgentBrain::dwraon() const { return d; }
+AssemblyBrain& AgentBrain::assembly() { return a; }
+const AssemblyBrain& AgentBrain::assembly() const { return a; }
+DenseBrain& AgentBrain::dense() { return n; }
+const DenseBrain& AgentBrain::dense() const { return n; }
+
+void AgentBrain::tick(vector< float >& in, vector< float >& out)
+{
+    switch (t) {
+    case DWRAON: d.tick(in, out); break;
+    case ASSEMBLY: a.tick(in, out); break;
+    case DENSE: n.tick(in, out); break;
+    default: m.tick(in, out);
+    }
+}
+
+int AgentBrain::stateSize() const
+{
+    switch (t) {
+    case DWRAON: return d.stateSize();
+    case ASSEMBLY: return a.stateSize();
+    case DENSE: return n.stateSize();
+    default: return m.stateSize();
+    }
+}
+
+void AgentBrain::saveState(float* s) const
+{
+    switch (t) {
+    case DWRAON: d.saveState(s); break;
+    case ASSEMBLY: a.saveState(s); break;
+    case DENSE: n.saveState(s); break;
+    default: m.saveState(s);
+    }
+}
+
+void AgentBrain::restoreState(const float* s)
+{
+    switch (t) {
+    case DWRAON: d.restoreState(s); break;
+    case ASSEMBLY: a.restoreState(s); break;
+    case DENSE: n.restoreState(s); break;
+    default: m.restoreState(s);
+    }
+}
+
+void AgentBrain::mutate(float MR, float MR2, MutationLog* log)
+{
+    switch (t) {
+    case DWRAON: d.mutate(MR, MR2, log); break;
+    case ASSEMBLY: a.mutate(MR, MR2, log); break;
+    case DENSE: n.mutate(MR, MR2, log); break;
+    default: m.mutate(MR, MR2, log);
+    }
+}
+
+AgentBrain AgentBrain::crossover(const AgentBrain& other)
+{
+    if (t!=other.t) return AgentBrain(*this);
+    switch (t) {
+    case DWRAON: return AgentBrain(d.crossover(other.d));
+    case ASSEMBLY: return AgentBrain(a.crossover(other.a));
+    case DENSE: return AgentBrain(n.crossover(other.n));
+    default: return AgentBrain(m.crossover(other.m));
+    }
+}
+
+void AgentBrain::memoryUsage(size_t& payload, size_t& chunks) const
+{
+    switch (t) {
+    case DWRAON: d.memoryUsage(payload, chunks); break;
+    case ASSEMBLY: a.memoryUsage(payload, chunks); break;
+    case DENSE: n.memoryUsage(payload, chunks); break;
+    default: m.memoryUsage(payload, chunks);
+    }
+}
+
+void AgentBrain::setDefaultType(int type)
+{
+    DEFAULTTYPE= type;
+}
+
+int AgentBrain::defaultType()
+{
+    return DEFAULTTYPE;
+}
+
+const char* AgentBrain::typeName(int type)
+{
+    if (type==MIXED) return "mixed";
+    return NAMES[type];
+}
+
+int AgentBrain::typeByName(const char* name)
+{
+    if (strcmp(name, "mixed")==0) return MIXED;
+    for (int i=0;i<TYPES;i++) {
+        if (strcmp(name, NAMES[i])==0) return i;
+    }
+    return -2;
+}
+
+long AgentBrain::copies()
+{
+    return MLPBrain::copies + DWRAONBrain::copies + AssemblyBrain::copies + DenseBrain::copies;
+}
@@ -0,0 +1,76 @@
+#ifndef AGENTBRAIN_H
+#define AGENTBRAIN_H
+
+#include "MLPBrain.h"
+#include "DWRAONBrain.h"
+#include "AssemblyBrain.h"
+#include "DenseBrain.h"
+
+#include <vector>
+
+/**
+ * The brain of one agent, which can be any of the brain types. It is a
+ * tagged union: only the member of type() exists. World groups agents by
+ * type and runs each group through that type's own tick, so the type is
+ * looked at once per group rather than once per agent.
+ */
+class AgentBrain
+{
+public:
+    enum Type { MLP= 0, DWRAON, ASSEMBLY, DENSE, TYPES, MIXED= -1 };
+
+    AgentBrain(); //random brain of the default type
+    explicit AgentBrain(int type); //random brain of type
+    AgentBrain(MLPBrain&& b);
+    AgentBrain(DWRAONBrain&& b);
+    AgentBrain(AssemblyBrain&& b);
+    AgentBrain(DenseBrain&& b);
+    AgentBrain(const AgentBrain &other);
+    AgentBrain(AgentBrain &&other) noexcept;
+    ~AgentBrain();
+    AgentBrain& operator=(const AgentBrain& other);
+    AgentBrain& operator=(AgentBrain&& other) noexcept;
+
+    int type() const;
+    MLPBrain& mlp();
+    const MLPBrain& mlp() const;
+    DWRAONBrain& dwraon();
+    const DWRAONBrain& dwraon() const;
+    AssemblyBrain& assembly();
+    const AssemblyBrain& assembly() const;
+    DenseBrain& dense();
+    const DenseBrain& dense() const;
+
+    //per agent dispatch, for when there is no group to go with
+    void tick(std::vector<float>& in, std::vector<float>& out);
+    void mutate(float MR, float MR2, MutationLog* log= NULL);
+    AgentBrain crossover(const AgentBrain &other); //brains of different types don't mix, the child gets a copy of this one
+    void memoryUsage(size_t& payload, size_t& chunks) const;
+
+    //the state apart from the genome, as stateSize() floats (see each type)
+    int stateSize() const;
+    void saveState(float* s) const;
+    void restoreState(const float* s);
+
+    //type of brains made by AgentBrain(). MIXED picks one at random for each
+    static void setDefaultType(int type);
+    static int defaultType();
+    static const char* typeName(int type);
+    static int typeByName(const char* name); //MIXED for "mixed", -2 if unknown
+
+    static long copies(); //deep copies made so far, of all types together
+
+private:
+    void construct(int type);
+    void destroy();
+
+    int t;
+    union {
+        MLPBrain m;
+        DWRAONBrain d;
+        AssemblyBrain a;
+        DenseBrain n;
+    };
+};
+
+#endif
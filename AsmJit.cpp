@@ -0,0 +1,506 @@
+#include "AsmJit.h"
+
+#include "AssemblyBrain.h"
+
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#if defined(__x86_64__) && defined(__linux__)
+#define ASMJIT_X64
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+long AsmJit::builds= 0;
+double AsmJit::buildseconds= 0;
+long AsmJit::exits= 0;
+
+#ifdef ASMJIT_X64
+static bool ENABLED= true;
+#else
+static bool ENABLED= false;
+#endif
+
+#ifdef ASMJIT_X64
+
+//Programs are small (a few hundred bytes) and one is run per agent per tick,
+//so a page and an mmap each would cost more than the native code saves. They
+//share slabs that are mapped twice from one memfd instead: written through a
+//writable view, run from an executable one, so no page is ever both and
+//nothing needs mprotect while other threads run code from the same slab
+const size_t POOLUNIT= 64; //bytes, a cache line
+const size_t POOLMAX= 64; //units, larger programs get their own pages
+const size_t SLABSIZE= 1<<20;
+
+static int poolfd= -2; //-2 not tried yet, -1 no memfd
+static size_t poolsize= 0; //bytes of the file mapped so far
+static char* slabrw= NULL; //views of the current slab
+static char* slabrx= NULL;
+static size_t slabused= SLABSIZE;
+static vector<char*> poolfree[POOLMAX+1]; //executable addresses of free runs, by length in units
+static vector<ptrdiff_t> slaboff; //rw-rx distance of each slab,
+static vector<char*> slabstart; //which starts at this executable address
+
+static bool newSlab()
+{
+    if (poolfd==-2) poolfd= (int) syscall(SYS_memfd_create, "asmjit", 0);
+    if (poolfd<0 || ftruncate(poolfd, poolsize+SLABSIZE)!=0) return false;
+    void* rw= mmap(NULL, SLABSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, poolfd, poolsize);
+    if (rw==MAP_FAILED) return false;
+    void* rx= mmap(NULL, SLABSIZE, PROT_READ|PROT_EXEC, MAP_SHARED, poolfd, poolsize);
+    if (rx==MAP_FAILED) {
+        munmap(rw, SLABSIZE);
+        return false;
+    }
+    poolsize+= SLABSIZE;
+    slabrw= (char*) rw;
+    slabrx= (char*) rx;
+    slabused= 0;
+    slaboff.push_back(slabrw-slabrx);
+    slabstart.push_back(slabrx);
+    return true;
+}
+
+//copies n bytes of code into the pool. Returns the executable address, or NULL
+static char* poolAlloc(const unsigned char* bytes, size_t n, size_t& len)
+{
+    size_t units= (n+POOLUNIT-1)/POOLUNIT;
+    if (units>POOLMAX) return NULL;
+    len= units*POOLUNIT;
+
+    char* rx= NULL;
+    #pragma omp critical(asmjitpool)
+    {
+        if (!poolfree[units].empty()) {
+            rx= poolfree[units].back();
+            poolfree[units].pop_back();
+        } else if (slabused+len<=SLABSIZE || newSlab()) {
+            rx= slabrx+slabused;
+            slabused+= len;
+        }
+        if (rx!=NULL) {
+            size_t s= slabstart.size()-1;
+            while (rx<slabstart[s] || rx>=slabstart[s]+SLABSIZE) s--;
+            memcpy(rx+slaboff[s], bytes, n);
+        }
+    }
+    return rx;
+}
+
+static void poolFree(char* rx, size_t len)
+{
+    #pragma omp critical(asmjitpool)
+    poolfree[len/POOLUNIT].push_back(rx);
+}
+
+#endif
+
+void AsmJit::setEnabled(bool on)
+{
+    ENABLED= on && available();
+}
+
+bool AsmJit::enabled()
+{
+    return ENABLED;
+}
+
+bool AsmJit::available()
+{
+#ifdef ASMJIT_X64
+    return true;
+#else
+    return false;
+#endif
+}
+
+AsmJit::AsmJit() :
+        fn(NULL),
+        len(0),
+        pooled(false)
+{
+}
+
+AsmJit::~AsmJit()
+{
+    clear();
+}
+
+void AsmJit::clear()
+{
+#ifdef ASMJIT_X64
+    if (fn!=NULL) {
+        if (pooled) poolFree((char*) fn, len);
+        else munmap((void*) fn, len);
+    }
+#endif
+    fn= NULL;
+    len= 0;
+    pooled= false;
+}
+
+bool AsmJit::ready() const
+{
+    return fn!=NULL;
+}
+
+size_t AsmJit::bytes() const
+{
+    return len;
+}
+
+void AsmJit::swap(AsmJit& other)
+{
+    Fn f= fn;
+    fn= other.fn;
+    other.fn= f;
+    size_t l= len;
+    len= other.len;
+    other.len= l;
+    bool p= pooled;
+    pooled= other.pooled;
+    other.pooled= p;
+}
+
+int AsmJit::run(float* w) const
+{
+    int r= fn(w);
+    if (r!=FINISHED) {
+        #pragma omp atomic
+        exits++;
+    }
+    return r;
+}
+
+#ifdef ASMJIT_X64
+
+//SSE scalar code. w is in rdi, the result in eax. Registers:
+//xmm0 value being stored, xmm1 xmm2 scratch, xmm3 abs mask, xmm4 2.0,
+//xmm5 3.0, xmm6 BRAINSIZE, xmm7 0.0, xmm8 10.0, xmm9 -10.0, xmm10 sign bit.
+//eax holds operand indices worked out while running, ecx is scratch
+class Emitter
+{
+public:
+    vector<unsigned char> b;
+
+    void byte(int x) { b.push_back((unsigned char) x); }
+    void u32(unsigned int x) { for (int i=0;i<4;i++) byte(x>>(8*i)); }
+
+    //op xmm, [rdi+4*i]
+    void mem(int p1, int p2, int op, int xmm, int i)
+    {
+        if (p1) byte(p1);
+        if (xmm>=8) byte(0x44);
+        byte(p2);
+        byte(op);
+        byte(0x80 | ((xmm&7)<<3) | 7);
+        u32(4*i);
+    }
+    //op xmm, [rdi+4*rax]
+    void memx(int p1, int p2, int op, int xmm)
+    {
+        if (p1) byte(p1);
+        if (xmm>=8) byte(0x44);
+        byte(p2);
+        byte(op);
+        byte(((xmm&7)<<3) | 4);
+        byte(0x87);
+    }
+    //op reg, rm with both in registers
+    void regs(int p1, int p2, int op, int reg, int rm)
+    {
+        if (p1) byte(p1);
+        if (reg>=8 || rm>=8) byte(0x40 | (reg>=8 ? 4 : 0) | (rm>=8 ? 1 : 0));
+        byte(p2);
+        byte(op);
+        byte(0xC0 | ((reg&7)<<3) | (rm&7));
+    }
+
+    void load(int xmm, int i) { mem(0xF3, 0x0F, 0x10, xmm, i); } //movss xmm, w[i]
+    void store(int i, int xmm) { mem(0xF3, 0x0F, 0x11, xmm, i); } //movss w[i], xmm
+    void addm(int xmm, int i) { mem(0xF3, 0x0F, 0x58, xmm, i); }
+    void subm(int xmm, int i) { mem(0xF3, 0x0F, 0x5C, xmm, i); }
+    void mulm(int xmm, int i) { mem(0xF3, 0x0F, 0x59, xmm, i); }
+    void loadx(int xmm) { memx(0xF3, 0x0F, 0x10, xmm); } //the same with w[eax]
+    void storex(int xmm) { memx(0xF3, 0x0F, 0x11, xmm); }
+    void addx(int xmm) { memx(0xF3, 0x0F, 0x58, xmm); }
+    void subx(int xmm) { memx(0xF3, 0x0F, 0x5C, xmm); }
+    void mulx(int xmm) { memx(0xF3, 0x0F, 0x59, xmm); }
+    void movaps(int dst, int src) { regs(0, 0x0F, 0x28, dst, src); }
+    void andps(int dst, int src) { regs(0, 0x0F, 0x54, dst, src); }
+    void xorps(int dst, int src) { regs(0, 0x0F, 0x57, dst, src); }
+    void subss(int dst, int src) { regs(0xF3, 0x0F, 0x5C, dst, src); }
+    void mulss(int dst, int src) { regs(0xF3, 0x0F, 0x59, dst, src); }
+    void minss(int dst, int src) { regs(0xF3, 0x0F, 0x5D, dst, src); } //src if either is NaN
+    void maxss(int dst, int src) { regs(0xF3, 0x0F, 0x5F, dst, src); }
+    void ucomiss(int a, int c) { regs(0, 0x0F, 0x2E, a, c); }
+    void cvttss2si(int xmm) { regs(0xF3, 0x0F, 0x2C, 0, xmm); } //eax= (int) xmm
+    void cvtsi2ss(int xmm) { regs(0xF3, 0x0F, 0x2A, xmm, 0); } //xmm= (float) eax
+    void movd(int xmm) { regs(0x66, 0x0F, 0x6E, xmm, 0); } //xmm= eax, bitwise
+    void moveax(unsigned int x) { byte(0xB8); u32(x); }
+    void cmpeax(unsigned int x) { byte(0x3D); u32(x); }
+    void zeroecx() { byte(0x31); byte(0xC9); }
+    void cmovaeeaxecx() { byte(0x0F); byte(0x43); byte(0xC1); }
+    void ret() { byte(0xC3); }
+
+    //jcc or jmp rel32 to be patched later, returns where the offset sits
+    size_t jcc(int cc)
+    {
+        byte(0x0F);
+        byte(0x80 | cc);
+        u32(0);
+        return b.size()-4;
+    }
+    size_t jmp()
+    {
+        byte(0xE9);
+        u32(0);
+        return b.size()-4;
+    }
+    void patch(size_t at, size_t target)
+    {
+        unsigned int rel= (unsigned int) (target-(at+4));
+        for (int i=0;i<4;i++) b[at+i]= (unsigned char) (rel>>(8*i));
+    }
+
+    void constant(int xmm, float f)
+    {
+        unsigned int bits;
+        memcpy(&bits, &f, sizeof(bits));
+        moveax(bits);
+        movd(xmm);
+    }
+};
+
+const int JB= 0x2, JAE= 0x3, JBE= 0x6, JNE= 0x5;
+
+//smallest float that is not below t, so that v<t and v<above(t) agree for every float v
+static float above(double t)
+{
+    float f= (float) t;
+    if (f<t) f= nextafterf(f, 3*f);
+    return f;
+}
+
+//where AssemblyBrain::decode puts the opcode of each AsmOp::Code
+static const double OPSTART[AsmOp::COPY+2]= {0, 2, 2.1, 2.2, 2.3, 2.4, 2.5, 2.7, 3};
+
+typedef vector<pair<size_t,int> > Exits; //jumps to the early return with a value
+
+//eax= the box index of the word in xmm2, as AssemblyBrain's operand() has it.
+//Clobbers xmm1 and xmm2
+static void operandIndex(Emitter& e)
+{
+    e.andps(2, 3);
+    e.cvttss2si(2);
+    e.cvtsi2ss(1);
+    e.subss(2, 1);
+    e.mulss(2, 6);
+    e.cvttss2si(2);
+    e.zeroecx();
+    e.cmpeax(BRAINSIZE);
+    e.cmovaeeaxecx(); //out of range, negative too: box 0
+}
+
+//compares the value in xmm0, now in w[dst], with the program as it was
+//compiled, jumping to the return of stop where it differs. Only instruction
+//dst itself, if it comes after position after...
+static void opcodeGuard(Emitter& e, const AsmOp* code, int dst, int after, int stop, Exits& exits)
+{
+    const int end= BRAINSIZE-OUTPUTSIZE;
+    if (dst<=after || dst<INPUTSIZE || dst>=end) return;
+
+    int op= code[dst].op;
+    e.constant(1, above(op==AsmOp::NOP ? 2 : OPSTART[op]));
+    e.ucomiss(0, 1);
+    if (op==AsmOp::NOP) {
+        //still no instruction unless in [2,3)
+        size_t below= e.jcc(JB);
+        e.ucomiss(0, 5);
+        exits.push_back(make_pair(e.jcc(JB), stop));
+        e.patch(below, e.b.size());
+    } else {
+        //still the same instruction, false for NaN too
+        exits.push_back(make_pair(e.jcc(JB), stop));
+        e.constant(1, above(OPSTART[op+1]));
+        e.ucomiss(0, 1);
+        exits.push_back(make_pair(e.jcc(JAE), stop));
+    }
+}
+
+//...or the three before it, that w[dst] may be an operand of
+static void operandGuard(Emitter& e, const AsmOp* code, int dst, int stop, Exits& exits)
+{
+    const int end= BRAINSIZE-OUTPUTSIZE;
+    bool computed= false;
+    for (int k=dst-3;k<dst;k++) {
+        if (k<INPUTSIZE || k>=end || code[k].op==AsmOp::NOP) continue;
+        int slot= dst-k;
+        if (!code[k].uses(slot)) continue;
+        if (!computed) {
+            e.movaps(2, 0);
+            operandIndex(e);
+            computed= true;
+        }
+        int d= slot==1 ? code[k].d1 : slot==2 ? code[k].d2 : code[k].d3;
+        e.cmpeax(d);
+        exits.push_back(make_pair(e.jcc(JNE), stop));
+    }
+}
+
+bool AsmJit::build(const AsmOp* code, const unsigned char* next)
+{
+    chrono::steady_clock::time_point t0= chrono::steady_clock::now();
+    clear();
+    const int end= BRAINSIZE-OUTPUTSIZE;
+
+    Emitter e;
+    e.b.reserve(4096);
+    Exits exits;
+    vector<char> stored(BRAINSIZE, 0); //words some instruction writes
+
+    unsigned int absmask= 0x7fffffff;
+    e.moveax(absmask);
+    e.movd(3);
+    e.constant(4, 2.0f);
+    e.constant(5, 3.0f);
+    e.constant(6, (float) BRAINSIZE);
+    e.xorps(7, 7);
+    e.constant(8, 10.0f);
+    e.constant(9, -10.0f);
+    e.constant(10, -0.0f);
+
+    for (int i=next[INPUTSIZE];i<end;i=next[i+1]) {
+        const AsmOp& c= code[i];
+        size_t skip= 0;
+        //an operand word an earlier instruction wrote this tick may point
+        //elsewhere than it did at compile time, those are looked up as it runs
+        bool dyn1= stored[i+1], dyn2= stored[i+2] && c.uses(2), dyn3= stored[i+3];
+        int dst, slot;
+
+        switch (c.op) {
+        case AsmOp::ADD:
+        case AsmOp::SUB:
+        case AsmOp::MUL:
+            if (dyn1) { e.load(2, i+1); operandIndex(e); e.loadx(0); }
+            else e.load(0, c.d1);
+            if (dyn2) { e.load(2, i+2); operandIndex(e); }
+            if (c.op==AsmOp::ADD) { if (dyn2) e.addx(0); else e.addm(0, c.d2); }
+            if (c.op==AsmOp::SUB) { if (dyn2) e.subx(0); else e.subm(0, c.d2); }
+            if (c.op==AsmOp::MUL) { if (dyn2) e.mulx(0); else e.mulm(0, c.d2); }
+            if (dyn3) { e.load(2, i+3); operandIndex(e); }
+            dst= c.d3;
+            slot= 3;
+            break;
+        default:
+            //if(w[d3]>0), false for NaN too
+            if (dyn3) { e.load(2, i+3); operandIndex(e); e.loadx(1); }
+            else e.load(1, c.d3);
+            e.ucomiss(1, 7);
+            skip= e.jcc(JBE);
+            if (c.op==AsmOp::COPY) {
+                if (dyn2) { e.load(2, i+2); operandIndex(e); e.loadx(0); }
+                else e.load(0, c.d2);
+            }
+            if (dyn1) { e.load(2, i+1); operandIndex(e); }
+            if (c.op==AsmOp::ZERO) e.xorps(0, 0);
+            else if (c.op!=AsmOp::COPY) {
+                if (dyn1) e.loadx(0);
+                else e.load(0, c.d1);
+                if (c.op==AsmOp::NEGATE) e.xorps(0, 10);
+                else e.addm(0, i+2); //ADDIMM
+            }
+            dst= c.d1;
+            slot= 1;
+        }
+
+        //store. If it went elsewhere than at compile time, or changed an
+        //instruction still to come this tick, stop. Changes to the ones
+        //already done are looked at once at the end
+        if (slot==1 ? dyn1 : dyn3) {
+            e.storex(0);
+            e.cmpeax(dst);
+            exits.push_back(make_pair(e.jcc(JNE), i));
+        } else {
+            e.store(dst, 0);
+        }
+        stored[dst]= 1;
+        opcodeGuard(e, code, dst, i, i, exits);
+
+        if (skip) e.patch(skip, e.b.size());
+    }
+
+    //cap all to -10,10 like AssemblyBrain::tick. The words nothing writes
+    //were capped on earlier ticks already. NaN stays NaN, as there
+    for (int d=INPUTSIZE;d<end;d++) {
+        if (!stored[d]) continue;
+        e.load(0, d);
+        e.movaps(1, 8);
+        e.minss(1, 0);
+        e.movaps(0, 9);
+        e.maxss(0, 1);
+        e.store(d, 0);
+    }
+
+    //then see whether the program as it is now is the one compiled
+    for (int d=0;d<BRAINSIZE;d++) {
+        if (!stored[d]) continue;
+        e.load(0, d);
+        opcodeGuard(e, code, d, -1, REWRITTEN, exits);
+        operandGuard(e, code, d, REWRITTEN, exits);
+    }
+    e.moveax((unsigned int) FINISHED);
+    e.ret();
+
+    //one return per value, the jumps to it are in a row
+    int last= FINISHED;
+    size_t stub= 0;
+    for (size_t j=0;j<exits.size();j++) {
+        if (exits[j].second!=last) {
+            last= exits[j].second;
+            stub= e.b.size();
+            e.moveax((unsigned int) last);
+            e.ret();
+        }
+        e.patch(exits[j].first, stub);
+    }
+
+    size_t n;
+    char* p= poolAlloc(&e.b[0], e.b.size(), n);
+    if (p!=NULL) {
+        pooled= true;
+    } else {
+        //too big for the pool, or no memfd: pages of its own
+        size_t pagesize= 4096;
+        n= (e.b.size()+pagesize-1)/pagesize*pagesize;
+        void* q= mmap(NULL, n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (q==MAP_FAILED) return false;
+        memcpy(q, &e.b[0], e.b.size());
+        if (mprotect(q, n, PROT_READ|PROT_EXEC)!=0) {
+            munmap(q, n);
+            return false;
+        }
+        p= (char*) q;
+    }
+    fn= (Fn) p;
+    len= n;
+
+    double secs= chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+    #pragma omp atomic
+    builds++;
+    #pragma omp atomic
+    buildseconds+= secs;
+    return true;
+}
+
+#else
+
+bool AsmJit::build(const AsmOp*, const unsigned char*)
+{
+    return false;
+}
+
+#endif
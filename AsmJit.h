@@ -0,0 +1,64 @@
+#ifndef ASMJIT_H
+#define ASMJIT_H
+
+#include <stddef.h>
+
+struct AsmOp;
+
+/**
+ * Native x86-64 code for one decoded AssemblyBrain program, in mmap'd
+ * executable pages shared with other programs. The code does the whole
+ * tick after the inputs: the instructions in order straight on w[], then
+ * the cap to [-10,10]. Every store is checked against the program it was
+ * compiled from. If it changes an instruction that is still to run this
+ * tick the code returns early, so the caller can decode again and finish
+ * in the interpreter. Changes to instructions that already ran only
+ * matter if they are still there after the cap, so those are checked at
+ * the end.
+ * Everywhere but x86-64 Linux build() fails and the interpreter does it all.
+ */
+class AsmJit
+{
+public:
+    AsmJit();
+    ~AsmJit();
+
+    //compile code[] (as decoded from w, one entry per word, see AssemblyBrain)
+    //into native code. Returns false if there is no JIT on this platform
+    bool build(const AsmOp* code, const unsigned char* next);
+    void clear();
+    bool ready() const;
+    size_t bytes() const;
+
+    enum { FINISHED= -1, REWRITTEN= -2 };
+
+    //runs the program on w. Returns FINISHED if it ran to the end and the
+    //program is the same, REWRITTEN if it ran to the end but the program
+    //changed, otherwise the position of the instruction that changed the
+    //program for what was still to run, which did finish. Only FINISHED
+    //and REWRITTEN have capped w
+    int run(float* w) const;
+
+    void swap(AsmJit& other);
+
+    //runtime switch, on by default where there is a JIT
+    static void setEnabled(bool on);
+    static bool enabled();
+    static bool available(); //compiled in for this platform
+
+    //totals over all brains, for benchmarks
+    static long builds;
+    static double buildseconds;
+    static long exits; //runs that stopped early because the program changed
+
+private:
+    typedef int (*Fn)(float* w);
+    Fn fn;
+    size_t len;
+    bool pooled; //fn is in the shared pool rather than pages of its own
+
+    AsmJit(const AsmJit& other);
+    AsmJit& operator=(const AsmJit& other);
+};
+
+#endif
@@ -1,7 +1,11 @@
 #include "AssemblyBrain.h"
+#include <string.h>
 #include <stdio.h>
+#include <algorithm>
 using namespace std;
 
+long AssemblyBrain::copies= 0;
+
 AssemblyBrain::AssemblyBrain()
 {
     
@@ -18,21 +22,193 @@ AssemblyBrain::AssemblyBrain()
 }
 void AssemblyBrain::init()
 {
+    genomeChanged();
+}
+
+void AssemblyBrain::genomeChanged()
+{
+    compile();
+    jit.clear();
+    jitfails= 0;
+    calm= 0;
+}
+
+//box index an operand word points at: its fractional part, scaled to BRAINSIZE.
+//Words too large for an int used to index out of bounds, now they point at box 0
+static int operand(float v)
+{
+    int d= (int)BRAINSIZE*(fabs(v)-((int)fabs(v)));
+    return d>=0 && d<BRAINSIZE ? d : 0;
+}
+
+void AssemblyBrain::decode(int i)
+{
+    AsmOp& c= code[i];
+    c.op= AsmOp::NOP;
+    float v= w[i];
+
+    //words in [2,3) are instructions, the three after them their operands
+    if (!(v>=2 && v<3)) return;
+    c.d1= operand(w[i+1]);
+    c.d2= operand(w[i+2]);
+    c.d3= operand(w[i+3]);
+    if(v<2.1) c.op= AsmOp::ADD;
+    else if(v<2.2) c.op= AsmOp::SUB;
+    else if(v<2.3) c.op= AsmOp::MUL;
+    else if(v<2.4) c.op= AsmOp::ZERO;
+    else if(v<2.5) c.op= AsmOp::NEGATE;
+    else if(v<2.7) c.op= AsmOp::ADDIMM;
+    else c.op= AsmOp::COPY;
+}
+
+void AssemblyBrain::link(int i)
+{
+    int n= code[i].op!=AsmOp::NOP ? i : next[i+1];
+    next[i]= n;
+    for (int k=i-1;k>=INPUTSIZE && code[k].op==AsmOp::NOP;k--) next[k]= n;
 }
 
-AssemblyBrain::AssemblyBrain(const AssemblyBrain& other)
+void AssemblyBrain::compile()
+{
+    const int end= BRAINSIZE-OUTPUTSIZE;
+    code.resize(BRAINSIZE);
+    next.resize(end+1);
+    next[end]= end;
+    for (int i=end-1;i>=INPUTSIZE;i--) {
+        decode(i);
+        next[i]= code[i].op!=AsmOp::NOP ? i : next[i+1];
+    }
+}
+
+bool AssemblyBrain::set(int i, float v)
+{
+    const int end= BRAINSIZE-OUTPUTSIZE;
+    float old= w[i];
+    w[i]= v;
+    bool changed= false;
+
+    //w[i] is the opcode of instruction i...
+    if (i>=INPUTSIZE && i<end && ((old>=2 && old<3) || (v>=2 && v<3))) {
+        AsmOp was= code[i];
+        decode(i);
+        const AsmOp& c= code[i];
+        if ((was.op!=AsmOp::NOP)!=(c.op!=AsmOp::NOP)) link(i);
+        changed= was.op!=c.op || was.d1!=c.d1 || was.d2!=c.d2 || was.d3!=c.d3;
+    }
+
+    //...and an operand of the three before it
+    for (int k=i-1;k>=i-3 && k>=INPUTSIZE;k--) {
+        if (k>=end || code[k].op==AsmOp::NOP) continue;
+        AsmOp& c= code[k];
+        unsigned char* d= i-k==1 ? &c.d1 : i-k==2 ? &c.d2 : &c.d3;
+        unsigned char nd= operand(v);
+        if (*d!=nd && c.uses(i-k)) changed= true;
+        *d= nd;
+    }
+    return changed;
+}
+
+void AssemblyBrain::memoryUsage(size_t& payload, size_t& chunks) const
+{
+    size_t bytes[3]= {w.capacity()*sizeof(float), code.capacity()*sizeof(AsmOp), next.capacity()};
+    for (int i=0;i<3;i++) {
+        payload+= bytes[i];
+        chunks+= heapChunk(bytes[i]);
+    }
+    payload+= jit.bytes(); //native code, in cache lines or pages
+    chunks+= jit.bytes();
+}
+
+//copies compile their own native code, on the same schedule
+int AssemblyBrain::stateSize() const
+{
+    return BRAINSIZE;
+}
+
+void AssemblyBrain::saveState(float* s) const
+{
+    for (int i=0;i<BRAINSIZE;i++) s[i]= w[i];
+}
+
+void AssemblyBrain::restoreState(const float* s)
+{
+    if (std::equal(s, s+BRAINSIZE, w.begin())) return; //same program, keep its native code
+    w.assign(s, s+BRAINSIZE);
+    genomeChanged();
+}
+
+AssemblyBrain::AssemblyBrain(const AssemblyBrain& other) :
+        jitfails(other.jitfails),
+        calm(other.calm)
 {
     w = other.w;
+    code = other.code;
+    next = other.next;
+    copies++;
+}
+
+AssemblyBrain::AssemblyBrain(AssemblyBrain&& other) noexcept :
+        jitfails(other.jitfails),
+        calm(other.calm)
+{
+    w.swap(other.w);
+    code.swap(other.code);
+    next.swap(other.next);
+    jit.swap(other.jit);
 }
 
 AssemblyBrain& AssemblyBrain::operator=(const AssemblyBrain& other)
 {
     if( this != &other ) {
         w = other.w;
+        code = other.code;
+        next = other.next;
+        jit.clear();
+        jitfails= other.jitfails;
+        calm= other.calm;
+        copies++;
+    }
+    return *this;
+}
+
+AssemblyBrain& AssemblyBrain::operator=(AssemblyBrain&& other) noexcept
+{
+    if( this != &other ) {
+        w.swap(other.w);
+        code.swap(other.code);
+        next.swap(other.next);
+        jit.swap(other.jit);
+        int f= jitfails;
+        jitfails= other.jitfails;
+        other.jitfails= f;
+        int c= calm;
+        calm= other.calm;
+        other.calm= c;
     }
     return *this;
 }
 
+bool AssemblyBrain::run(int from)
+{
+    const int end= BRAINSIZE-OUTPUTSIZE;
+    bool changed= false;
+    for (int i=next[from];i<end;i=next[i+1]) {
+        const AsmOp c= code[i]; //by value, set() may decode it again
+        bool ch= false;
+        switch (c.op) {
+        case AsmOp::ADD: ch= set(c.d3, w[c.d1] + w[c.d2]); break;
+        case AsmOp::SUB: ch= set(c.d3, w[c.d1] - w[c.d2]); break;
+        case AsmOp::MUL: ch= set(c.d3, w[c.d1] * w[c.d2]); break;
+        case AsmOp::ZERO: if(w[c.d3]>0) ch= set(c.d1, 0); break;
+        case AsmOp::NEGATE: if(w[c.d3]>0) ch= set(c.d1, -w[c.d1]); break;
+        case AsmOp::ADDIMM: if(w[c.d3]>0) ch= set(c.d1, w[c.d1] + w[i+2]); break;
+        case AsmOp::COPY: if(w[c.d3]>0) ch= set(c.d1, w[c.d2]); break;
+        }
+        if (ch) changed= true;
+    }
+    return changed;
+}
+
 void AssemblyBrain::tick(vector< float >& in, vector< float >& out)
 {
     //do a single tick of the brain
@@ -42,36 +218,50 @@ void AssemblyBrain::tick(vector< float >& in, vector< float >& out)
         w[i]= in[i];
     }
     
-    //TICK!
-    for (int i=INPUTSIZE;i<BRAINSIZE-OUTPUTSIZE;i++) {
-        float v = w[i];
-        
-        //this is an operand
-        if(v>=2 && v<3){
-            float v1 = w[i+1];
-            float v2 = w[i+2];
-            float v3 = w[i+3];
-            int d1 = (int)BRAINSIZE*(fabs(v1)-((int)fabs(v1)));
-            int d2 = (int)BRAINSIZE*(fabs(v2)-((int)fabs(v2)));
-            int d3 = (int)BRAINSIZE*(fabs(v3)-((int)fabs(v3)));
-            
-           // printf("%f d1=%d d2=%d d3=%d\n", v, d1, d2, d3);
-            
-            if(v<2.1) { w[d3] = w[d1] + w[d2]; continue;}
-            if(v<2.2) { w[d3] = w[d1] - w[d2]; continue;}
-            if(v<2.3) { w[d3] = w[d1] * w[d2]; continue;}
-            if(v<2.4) { if(w[d3]>0) w[d1] = 0; continue;}            
-            if(v<2.5) { if(w[d3]>0) w[d1] = -w[d1]; continue;}
-            if(v<2.7) { if(w[d3]>0) w[d1] += v2; continue;}
-            if(v<3) { if(w[d3]>0) w[d1] = w[d2]; continue;}
+    //TICK! The inputs can't have changed the program, no instruction
+    //starts before INPUTSIZE and operands follow their opcode
+    const int end= BRAINSIZE-OUTPUTSIZE;
+    int from= INPUTSIZE;
+    bool changed= false;
+    const int wait= JITWARMUP<<jitfails;
+    if (!jit.ready() && calm>=wait && AsmJit::enabled()) {
+        if (!jit.build(&code[0], &next[0])) {
+            jitfails= MAXJITFAILS;
+            calm= 0;
         }
     }
+    bool capped= false;
+    if (jit.ready()) {
+        int stop= jit.run(&w[0]);
+        if (stop!=AsmJit::FINISHED) {
+            //the native code didn't keep code[] up to date
+            compile();
+            changed= true;
+        }
+        if (stop<0) {
+            from= end;
+            capped= true;
+        } else {
+            from= stop+1;
+        }
+    }
+    if (run(from)) changed= true;
     
     //cap all to -10,10
-    for(int i=INPUTSIZE;i<BRAINSIZE-OUTPUTSIZE;i++){
-        float v = w[i];
-        if(v>10)w[i]=10;
-        if(v<-10)w[i]=-10;
+    if (!capped) {
+        for(int i=INPUTSIZE;i<end;i++){
+            float v = w[i];
+            if(v>10 && set(i, 10)) changed= true;
+            if(v<-10 && set(i, -10)) changed= true;
+        }
+    }
+
+    if (changed && jit.ready()) {
+        jit.clear();
+        if (jitfails<MAXJITFAILS) jitfails++;
+        calm= 0;
+    } else if (!jit.ready() && calm<wait) {
+        calm++;
     }
     
     //finally set out[] to the last few boxes output
@@ -83,27 +273,36 @@ void AssemblyBrain::tick(vector< float >& in, vector< float >& out)
     }
 }
 
-void AssemblyBrain::mutate(float MR, float MR2)
+void AssemblyBrain::mutate(float MR, float MR2, MutationLog* log)
 {
-    for (int j=0;j<BRAINSIZE;j++) {
-        if(randf(0,1)<MR) {
-            w[j] = randf(-3,3);
-        }
+    //only visit the words that mutate, each does with probability MR
+    for (int j=randskip(MR);j<BRAINSIZE;j+= 1+randskip(MR)) {
+        float old= w[j];
+        w[j] = randf(-3,3);
+        if (log) log->record(Mutation::CODE, j, 0, old, w[j]);
     }
+    genomeChanged();
 }
 
 AssemblyBrain AssemblyBrain::crossover(const AssemblyBrain& other)
 {
     //this could be made faster by returning a pointer
     //instead of returning by value
+    //each word comes from either parent by a coin flip. Start from this one
+    //and copy the runs of words that come from other
     AssemblyBrain newbrain(*this);
-    for (int i=0;i<newbrain.w.size(); i++) {
-        if(randf(0,1)<0.5){
-            newbrain.w[i] = this->w[i];
-        } else {
-            newbrain.w[i] = other.w[i];
+    RandBits coin;
+    int n= newbrain.w.size();
+    int run= -1;
+    for (int i=0;i<=n; i++) {
+        bool fromother= i<n && !coin.next();
+        if (fromother && run==-1) run= i;
+        if (!fromother && run!=-1) {
+            memcpy(&newbrain.w[run], &other.w[run], (i-run)*sizeof(float));
+            run= -1;
         }
     }
+    newbrain.genomeChanged();
     return newbrain;
 }
 
@@ -3,10 +3,34 @@
 
 #include "settings.h"
 #include "helpers.h"
+#include "MutationLog.h"
+#include "AsmJit.h"
 #include <vector>
 
+#if BRAINSIZE>255
+#error "AssemblyBrain keeps operand indices in a byte, BRAINSIZE must be at most 255"
+#endif
+
+//one decoded instruction of an AssemblyBrain
+struct AsmOp {
+    enum Code { NOP= 0, ADD, SUB, MUL, ZERO, NEGATE, ADDIMM, COPY };
+    unsigned char op;
+    unsigned char d1, d2, d3; //operand indices into w. ADDIMM adds w[i+2] itself
+
+    bool uses(int slot) const //reads operand index d<slot>?
+    {
+        return slot!=2 || op==ADD || op==SUB || op==MUL || op==COPY;
+    }
+};
+
 /**
  * Assembly Brain
+ * w[] is program and memory at once. code[] is w decoded: code[i] is the
+ * instruction that w[i..i+3] spell right now. Every write to w goes through
+ * set(), which decodes the few instructions that word is part of again, so
+ * code[] stays exact even when the program rewrites itself.
+ * Where AsmJit works, code[] is also compiled to native code once per
+ * genome, which runs the tick until the program rewrites itself.
  */
 class AssemblyBrain
 {
@@ -16,14 +40,44 @@ public:
 
     AssemblyBrain();
     AssemblyBrain(const AssemblyBrain &other);
+    AssemblyBrain(AssemblyBrain &&other) noexcept;
     virtual AssemblyBrain& operator=(const AssemblyBrain& other);
+    virtual AssemblyBrain& operator=(AssemblyBrain&& other) noexcept;
 
     void tick(std::vector<float>& in, std::vector<float>& out);
-    void mutate(float MR, float MR2);
+    void mutate(float MR, float MR2, MutationLog* log= NULL); //log, if given, records every mutation
     AssemblyBrain crossover( const AssemblyBrain &other );
 
+    //the state, stateSize() floats written to or read from s. A program is its own
+    //memory, so this is all of w[] and restoring it may change the program too
+    int stateSize() const;
+    void saveState(float* s) const;
+    void restoreState(const float* s);
+
+    //adds the heap bytes this brain owns to payload, and what malloc really takes for them to chunks
+    void memoryUsage(size_t& payload, size_t& chunks) const;
+
+    static long copies; //number of deep copies made so far. Moves don't count
+    //ticks interpreted before a genome is compiled. The wait doubles each time
+    //the native code goes out of date, up to MAXJITFAILS times, so a program
+    //that keeps rewriting itself is mostly left to the interpreter
+    static const int JITWARMUP= 8;
+    static const int MAXJITFAILS= 7;
+
 private:
     void init();
+    void compile(); //decode all of w, after the genome changed
+    void decode(int i);
+    void link(int i); //fix up next[] around i after code[i] changed
+    bool set(int i, float v); //w[i]= v, keeping code[] in sync. True if the program changed
+    bool run(int from); //interpret from position from to the end. True if the program changed
+    void genomeChanged(); //decode again and give the JIT a new chance
+
+    std::vector<AsmOp> code;
+    std::vector<unsigned char> next; //next[i]: first i2>=i with an instruction, or BRAINSIZE-OUTPUTSIZE
+    AsmJit jit;
+    int jitfails; //times the native code went out of date since the genome last changed
+    int calm; //ticks interpreted since then
 };
 
 #endif
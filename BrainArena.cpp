@@ -0,0 +1,357 @@
+#include "BrainArena.h"
+
+#include "BrainShapes.h"
+#include "BulkAlloc.h"
+#include "Simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+using namespace std;
+
+const int LANES= BrainArena::LANES;
+
+static bool prune= false;
+
+void BrainArena::setPruning(bool on)
+{
+    prune= on;
+}
+
+bool BrainArena::pruning()
+{
+    return prune;
+}
+
+static int weightbits= 32;
+
+void BrainArena::setWeightBits(int bits)
+{
+    weightbits= bits;
+}
+
+int BrainArena::weightBits()
+{
+    return weightbits;
+}
+
+//the kernels the arena runs, for one shape of BrainShapes.h
+template <int N, int C>
+struct ArenaShape {
+    typedef MLPBoxesT<N,C> Boxes;
+    typedef MLPBlockT<N,C,INPUTSIZE> Block;
+    typedef MLPQBlockT<N,C,INPUTSIZE,int16_t> BlockQ16;
+    typedef MLPQBlockT<N,C,INPUTSIZE,int8_t> BlockQ8;
+
+    static size_t blockSize(int bits)
+    {
+        if (bits==16) return sizeof(BlockQ16);
+        if (bits==8) return sizeof(BlockQ8);
+        return sizeof(Block);
+    }
+
+    static void buildBlock(int bits, char* k, char* first, size_t stride, unsigned int full, unsigned int skip)
+    {
+        if (bits==16) mlpBuildBlock<N,C,INPUTSIZE,OUTPUTSIZE>(*(BlockQ16*) k, first, stride, full, skip);
+        else if (bits==8) mlpBuildBlock<N,C,INPUTSIZE,OUTPUTSIZE>(*(BlockQ8*) k, first, stride, full, skip);
+        else mlpBuildBlock<N,C,INPUTSIZE,OUTPUTSIZE>(*(Block*) k, first, stride, full, skip);
+    }
+
+    static void tickBlockKernel(int bits, const char* k, char* first, size_t stride, vector< float >* const* in, vector< float >* const* out)
+    {
+        if (bits==16) mlpTickBlock<N,C,INPUTSIZE,OUTPUTSIZE>(*(const BlockQ16*) k, first, stride, in, out);
+        else if (bits==8) mlpTickBlock<N,C,INPUTSIZE,OUTPUTSIZE>(*(const BlockQ8*) k, first, stride, in, out);
+        else mlpTickBlock<N,C,INPUTSIZE,OUTPUTSIZE>(*(const Block*) k, first, stride, in, out);
+    }
+
+    static void tickBlock(int bits, const char* k, char* first, size_t stride, vector< float >* const* in, vector< float >* const* out)
+    {
+        SIMD_CALL(tickBlockKernel, bits, k, first, stride, in, out);
+    }
+
+    //adds the boxes and synapses a plan computes of the brain at p, all of them or only the live ones
+    static void planStats(const char* p, bool all, long& boxes, long& synapses)
+    {
+        const Boxes& b= *(const Boxes*) p;
+        bool live[N];
+        if (!all) {
+            mlpLiveBoxes<N,C,INPUTSIZE,OUTPUTSIZE>(b, live);
+        } else {
+            for (int i=0;i<N;i++) live[i]= i>=INPUTSIZE;
+        }
+        for (int i=INPUTSIZE;i<N;i++) {
+            if (!live[i]) continue;
+            boxes++;
+            for (int j=0;j<C;j++) if (mlpSynapseLive(b, i, j)) synapses++;
+        }
+    }
+
+    static float out(const char* p, int box)
+    {
+        return ((const Boxes*) p)->now()[box];
+    }
+
+    static void saveState(const char* p, float* s)
+    {
+        const Boxes* b= (const Boxes*) p;
+        mlpSaveState<N>(b->out, b->cur, s);
+    }
+
+    static void restoreState(char* p, const float* s)
+    {
+        Boxes* b= (Boxes*) p;
+        mlpRestoreState<N>(s, b->out, b->cur);
+    }
+};
+
+//ArenaShape of every shape of BrainShapes.h, in that order
+struct ArenaOps {
+    int boxes, conns;
+    size_t slotbytes;
+    size_t (*blockSize)(int bits);
+    void (*buildBlock)(int bits, char* k, char* first, size_t stride, unsigned int full, unsigned int skip);
+    void (*tickBlock)(int bits, const char* k, char* first, size_t stride, vector< float >* const* in, vector< float >* const* out);
+    void (*planStats)(const char* p, bool all, long& boxes, long& synapses);
+    float (*out)(const char* p, int box);
+    void (*saveState)(const char* p, float* s);
+    void (*restoreState)(char* p, const float* s);
+};
+
+#define ARENA_OPS(n,c) { n, c, sizeof(ArenaShape<n,c>::Boxes), ArenaShape<n,c>::blockSize, \
+        ArenaShape<n,c>::buildBlock, ArenaShape<n,c>::tickBlock, ArenaShape<n,c>::planStats, \
+        ArenaShape<n,c>::out, ArenaShape<n,c>::saveState, ArenaShape<n,c>::restoreState },
+static const ArenaOps SHAPES[]= { MLP_SHAPES(ARENA_OPS) };
+
+BrainArena::BrainArena() :
+        ops(&SHAPES[MLPBrain::shape()]),
+        mem(NULL),
+        stride((ops->slotbytes+CACHELINE-1)/CACHELINE*CACHELINE),
+        cap(0),
+        bits(weightbits),
+        blockbytes((ops->blockSize(weightbits)+CACHELINE-1)/CACHELINE*CACHELINE),
+        blocks(NULL),
+        shown(-1)
+{
+}
+
+BrainArena::~BrainArena()
+{
+    for (int s=0;s<cap;s++) MLPNative::drop(natives[s]);
+    bulkFree(mem);
+    bulkFree(blocks);
+}
+
+char* BrainArena::slot(int i) const
+{
+    return mem + i*stride;
+}
+
+void BrainArena::grow()
+{
+    int newcap= cap==0 ? 64 : 2*cap;
+    char* newmem= (char*) bulkAlloc(newcap*stride);
+    if (newmem==NULL) {
+        printf("BrainArena: out of memory growing to %i slots\n", newcap);
+        exit(1);
+    }
+    if (mem!=NULL) memcpy(newmem, mem, cap*stride);
+    memset(newmem+cap*stride, 0, (newcap-cap)*stride); //free slots get ticked along with their block
+    bulkFree(mem);
+    mem= newmem;
+
+    //block genomes hold offsets relative to their own block, so they survive the move
+    char* newblocks= (char*) bulkAlloc(newcap/LANES*blockbytes);
+    if (newblocks==NULL) {
+        printf("BrainArena: out of memory growing to %i slots\n", newcap);
+        exit(1);
+    }
+    if (blocks!=NULL) memcpy(newblocks, blocks, cap/LANES*blockbytes);
+    bulkFree(blocks);
+    blocks= newblocks;
+    blockdirty.resize(newcap/LANES, 1);
+    ticks.resize(newcap, 0);
+    natives.resize(newcap, (MLPNative::Code*) NULL);
+    nativeon.resize(newcap, 0);
+
+    //hand out low slots first, so live brains stay packed at the front
+    for (int i=newcap-1;i>=cap;i--) freeslots.push_back(i);
+    inuse.resize(newcap, 0);
+    cap= newcap;
+}
+
+int BrainArena::alloc()
+{
+    if (freeslots.empty()) grow();
+    int s= freeslots.back();
+    freeslots.pop_back();
+    inuse[s]= 1;
+    return s;
+}
+
+void BrainArena::release(int slot)
+{
+    dropNative(slot);
+    inuse[slot]= 0;
+    freeslots.push_back(slot);
+}
+
+void BrainArena::clear()
+{
+    for (int s=0;s<cap;s++) dropNative(s);
+    freeslots.clear();
+    for (int i=cap-1;i>=0;i--) freeslots.push_back(i);
+    inuse.assign(cap, 0);
+}
+
+void BrainArena::load(int s, const MLPBrain& brain)
+{
+    brain.store(slot(s));
+    blockdirty[s/LANES]= 1;
+    dropNative(s);
+    ticks[s]= 0;
+}
+
+void BrainArena::dropNative(int s)
+{
+    MLPNative::drop(natives[s]);
+    natives[s]= NULL;
+    if (nativeon[s]) blockdirty[s/LANES]= 1;
+    nativeon[s]= 0;
+}
+
+void BrainArena::store(int s, MLPBrain& brain) const
+{
+    //the genome in the slot is the one loaded from this brain, so a brain
+    //that still has it (and may share it with others) takes only the state
+    if (brain.empty()) brain.load(slot(s));
+    else brain.loadState(slot(s));
+}
+
+void BrainArena::tick(int s, vector< float >& in, vector< float >& out)
+{
+    MLPBrain::tick(slot(s), in, out);
+}
+
+void BrainArena::buildBlock(int b)
+{
+    unsigned int full= 0;
+    if (!prune) full= (1u<<LANES)-1;
+    else if (shown!=-1 && shown/LANES==b) full= 1u<<(shown%LANES);
+    unsigned int skip= 0;
+    for (int l=0;l<LANES;l++) if (nativeon[b*LANES+l]) skip|= 1u<<l;
+    ops->buildBlock(bits, blocks + b*blockbytes, slot(b*LANES), stride, full, skip);
+    blockdirty[b]= 0;
+}
+
+void BrainArena::setShown(int s)
+{
+    if (s==shown) return;
+    if (shown!=-1) blockdirty[shown/LANES]= 1;
+    if (s!=-1) blockdirty[s/LANES]= 1;
+    shown= s;
+}
+
+void BrainArena::planStats(long& boxes, long& synapses) const
+{
+    boxes= 0;
+    synapses= 0;
+    for (int s=0;s<cap;s++) {
+        if (!inuse[s]) continue;
+        //blocks are only built once they tick, so count from the slot itself
+        ops->planStats(slot(s), !prune || s==shown, boxes, synapses);
+    }
+}
+
+void BrainArena::tickBlock(int b, vector< float >* const* in, vector< float >* const* out)
+{
+    ops->tickBlock(bits, blocks + b*blockbytes, slot(b*LANES), stride, in, out);
+}
+
+void BrainArena::tickAll(vector< float >* const* in, vector< float >* const* out)
+{
+    //slots with native code ready tick on their own, the blocks do the rest
+    vector< vector<float>* > blockin(in, in+cap);
+    vector<int> native;
+    bool usenative= MLPNative::enabled() && bits==32;
+    if (usenative) MLPNative::poll();
+    for (int s=0;s<cap;s++) {
+        if (in[s]==NULL) continue;
+        if (usenative && ++ticks[s]==conf::MLPNATIVETICKS && natives[s]==NULL) {
+            natives[s]= MLPNative::request(slot(s), !prune);
+        }
+        bool on= usenative && natives[s]!=NULL && MLPNative::ready(natives[s]) && s!=shown;
+        if (on!=(bool) nativeon[s]) {
+            nativeon[s]= on;
+            blockdirty[s/LANES]= 1;
+        }
+        if (!on) continue;
+        native.push_back(s);
+        blockin[s]= NULL;
+    }
+    MLPNative::ticks+= native.size();
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int k=0;k<(int) native.size();k++) {
+        int s= native[k];
+        MLPNative::tick(natives[s], slot(s), &(*in[s])[0], &(*out[s])[0]);
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int b=0;b<cap/LANES;b++) {
+        bool any= false;
+        for (int l=0;l<LANES;l++) any= any || blockin[b*LANES+l]!=NULL;
+        if (!any) continue;
+
+        if (blockdirty[b]) buildBlock(b);
+        tickBlock(b, &blockin[b*LANES], out+b*LANES);
+    }
+}
+
+float BrainArena::out(int s, int box) const
+{
+    return ops->out(slot(s), box);
+}
+
+void BrainArena::saveState(int s, float* state) const
+{
+    ops->saveState(slot(s), state);
+}
+
+void BrainArena::restoreState(int s, const float* state)
+{
+    ops->restoreState(slot(s), state);
+}
+
+int BrainArena::capacity() const
+{
+    return cap;
+}
+
+int BrainArena::used() const
+{
+    return cap-freeslots.size();
+}
+
+size_t BrainArena::slotBytes() const
+{
+    return stride;
+}
+
+size_t BrainArena::blockBytes() const
+{
+    return blockbytes;
+}
+
+int BrainArena::blockWeightBits() const
+{
+    return bits;
+}
+
+bool BrainArena::write(FILE* fp) const
+{
+    int header[4]= {ops->boxes, ops->conns, cap, (int) stride};
+    if (fwrite(header, sizeof(header), 1, fp)!=1) return false;
+    if (cap==0) return true;
+    if (fwrite(&inuse[0], 1, cap, fp)!=(size_t) cap) return false;
+    return fwrite(mem, stride, cap, fp)==(size_t) cap;
+}
@@ -0,0 +1,113 @@
+#ifndef BRAINARENA_H
+#define BRAINARENA_H
+
+#include "MLPBrain.h"
+#include "MLPNative.h"
+
+#include <vector>
+#include <stdio.h>
+
+struct ArenaOps;
+
+/**
+ * Holds the brains of every agent in one contiguous, cache line aligned
+ * region of fixed stride slots, allocated with bulkAlloc so it can sit on
+ * huge pages. Agents refer to their network by slot index. A slot is an
+ * MLPBoxesT of the MLP brain shape in use when the arena was made.
+ * The Agent's own MLPBrain stays the genome used for mutation and crossover,
+ * the slot is where it actually runs.
+ *
+ * tickAll() runs the whole population in blocks of LANES consecutive slots.
+ * Each block keeps an interleaved copy of its genomes (synapse k of all
+ * LANES brains side by side), so one neuron is computed for all of them at
+ * once in SIMD lanes, gathering the source outputs straight from the slots.
+ * With pruning on, the block only computes the boxes of each brain that can
+ * reach its outputs through nonzero weights; the others keep their last
+ * state. The shown slot is computed in full, as the view draws every box.
+ * A mutation can make such a box live again with that stale state, so
+ * pruned runs don't follow the same trajectory as full ones.
+ * Blocks are rebuilt only when a slot's genome changes, i.e. on load().
+ * The block genomes can be kept as 16 or 8 bit weights instead of floats
+ * (see MLPQBlockT), which takes a fraction of the memory traffic for a small
+ * error. The slots, and so mutation and crossover, stay float either way.
+ * With MLPNative on, a slot whose genome has ticked conf::MLPNATIVETICKS
+ * times asks for native code for it, and once that is compiled the slot is
+ * ticked by it and left out of its block. Float weights only; a new genome
+ * in the slot goes back to the block.
+ */
+class BrainArena
+{
+public:
+    BrainArena();
+    ~BrainArena();
+
+    int alloc(); //index of a free slot. Grows the region if there is none
+    void release(int slot);
+    void clear();
+
+    void load(int slot, const MLPBrain &brain); //copy brain (genome and state) into slot
+    void store(int slot, MLPBrain &brain) const; //copy slot back into brain, which may be empty
+
+    void tick(int slot, std::vector<float>& in, std::vector<float>& out);
+    //tick every slot s with in[s]!=NULL, block by block and in parallel.
+    //Gives exactly the same results as calling tick() on each of them
+    void tickAll(std::vector<float>* const* in, std::vector<float>* const* out);
+    float out(int slot, int box) const;
+    //the state of slot, as MLPBrain::stateSize() floats. Its genome stays as it is
+    void saveState(int slot, float* s) const;
+    void restoreState(int slot, const float* s);
+
+    //slot whose every box is computed, for the agent selected in the view. -1 for none
+    void setShown(int slot);
+
+    //boxes and synapses of the in-use slots, as the block plans compute them
+    void planStats(long& boxes, long& synapses) const;
+
+    //runtime switch, off by default. Only takes effect as blocks are rebuilt,
+    //so set it before the first tick
+    static void setPruning(bool on);
+    static bool pruning();
+
+    //bits per weight in the block genomes: 32 (float, the default), 16 or 8.
+    //An arena keeps the one set when it was made
+    static void setWeightBits(int bits);
+    static int weightBits();
+    size_t blockBytes() const; //per block of LANES slots
+    int blockWeightBits() const; //the bits per weight of this arena
+
+    static const int LANES= MLPLANES; //brains per block
+
+    int capacity() const;
+    int used() const;
+    size_t slotBytes() const;
+
+    //snapshot of all slots: a small header, then the whole region in one write
+    bool write(FILE* fp) const;
+
+private:
+    char* slot(int i) const;
+    void grow();
+    void buildBlock(int b);
+    void dropNative(int slot);
+    void tickBlock(int b, std::vector<float>* const* in, std::vector<float>* const* out);
+
+    const ArenaOps* ops; //kernels of MLPBrain::shape() when the arena was made
+    char* mem;
+    size_t stride; //bytes per slot, sizeof(MLPBoxesT) rounded up to a cache line
+    int cap;
+    std::vector<int> freeslots;
+    std::vector<char> inuse;
+    int bits; //weightBits() when the arena was made
+    size_t blockbytes;
+    char* blocks; //cap/LANES of them, MLPBlockT or MLPQBlockT with 16 or 8 bit weights after bits
+    std::vector<char> blockdirty; //genome in the block is out of date with its slots
+    std::vector<int> ticks; //of each slot since its genome was loaded
+    std::vector<MLPNative::Code*> natives; //requested for each slot, or NULL
+    std::vector<char> nativeon; //slot is ticked by its native code, not in its block
+    int shown;
+
+    BrainArena(const BrainArena &other);
+    BrainArena& operator=(const BrainArena &other);
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "BrainShapes.h"
+
+#include "MLPKernels.h"
+#include "MLPBrain.h"
+#include "BrainArena.h"
+#include "BulkAlloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+template <int N, int C, class QBlock>
+static double quantError(int agents, int ticks, double& bound)
+{
+    typedef MLPBoxesT<N,C> Boxes;
+    typedef MLPBlockT<N,C,INPUTSIZE> Block;
+    int nblocks= (agents+MLPLANES-1)/MLPLANES;
+    int nslots= nblocks*MLPLANES;
+    size_t stride= (sizeof(Boxes)+CACHELINE-1)/CACHELINE*CACHELINE;
+    char* mem= (char*) bulkAlloc(2*nslots*stride);
+    Block* blocks= (Block*) bulkAlloc(nblocks*sizeof(Block));
+    QBlock* qblocks= (QBlock*) bulkAlloc(nblocks*sizeof(QBlock));
+    if (mem==NULL || blocks==NULL || qblocks==NULL) {
+        bulkFree(mem);
+        bulkFree(blocks);
+        bulkFree(qblocks);
+        return -1;
+    }
+    char* qmem= mem+nslots*stride; //same brains, ticked with the quantized weights
+
+    vector<vector<float> > ins(nslots, vector<float>(INPUTSIZE));
+    vector<vector<float> > outs(nslots, vector<float>(OUTPUTSIZE));
+    vector<vector<float> > qouts(nslots, vector<float>(OUTPUTSIZE));
+    vector<vector<float>*> inp(nslots), outp(nslots), qoutp(nslots);
+    for (int s=0;s<nslots;s++) {
+        mlpRandomize<N,C,INPUTSIZE>(*(Boxes*) (mem+s*stride));
+        inp[s]= &ins[s];
+        outp[s]= &outs[s];
+        qoutp[s]= &qouts[s];
+    }
+    unsigned int full= BrainArena::pruning() ? 0 : (1u<<MLPLANES)-1;
+    bound= 0;
+    for (int b=0;b<nblocks;b++) {
+        mlpBuildBlock<N,C,INPUTSIZE,OUTPUTSIZE>(blocks[b], mem+b*MLPLANES*stride, stride, full);
+        QBlock& k= qblocks[b];
+        mlpBuildBlock<N,C,INPUTSIZE,OUTPUTSIZE>(k, mem+b*MLPLANES*stride, stride, full);
+        for (int n=0;n<k.rows;n++) {
+            for (int l=0;l<MLPLANES;l++) {
+                int i= k.box[n][l];
+                if (i<0) continue;
+                const Boxes* m= (const Boxes*) (mem+(b*MLPLANES+l)*stride);
+                float reach= 0;
+                for (int j=0;j<C;j++) reach+= (k.type[n][l]>>j)&1 ? 10 : 1;
+                bound= max(bound, (double) k.gw[n][l]/2*reach/4*m->kp[i]);
+            }
+        }
+    }
+
+    //each tick starts the quantized brains from the state of the float ones,
+    //so this is the error of one tick, not what it adds up to
+    double err= 0;
+    for (int t=0;t<ticks;t++) {
+        for (int s=0;s<nslots;s++) {
+            for (int i=0;i<INPUTSIZE;i++) ins[s][i]= randf(0,1);
+        }
+        memcpy(qmem, mem, nslots*stride);
+        for (int b=0;b<nblocks;b++) {
+            mlpTickBlock<N,C,INPUTSIZE,OUTPUTSIZE>(blocks[b], mem+b*MLPLANES*stride, stride,
+                                                   &inp[b*MLPLANES], &outp[b*MLPLANES]);
+            mlpTickBlock<N,C,INPUTSIZE,OUTPUTSIZE>(qblocks[b], qmem+b*MLPLANES*stride, stride,
+                                                   &inp[b*MLPLANES], &qoutp[b*MLPLANES]);
+        }
+        for (int s=0;s<nslots;s++) {
+            for (int i=0;i<OUTPUTSIZE;i++) err= max(err, (double) fabsf(outs[s][i]-qouts[s][i]));
+        }
+    }
+
+    bulkFree(mem);
+    bulkFree(blocks);
+    bulkFree(qblocks);
+    return err;
+}
+
+template <int N, int C>
+static double quantError(int bits, int agents, int ticks, double& bound)
+{
+    if (bits==16) return quantError<N, C, MLPQBlockT<N,C,INPUTSIZE,int16_t> >(agents, ticks, bound);
+    if (bits==8) return quantError<N, C, MLPQBlockT<N,C,INPUTSIZE,int8_t> >(agents, ticks, bound);
+    return 0;
+}
+
+struct ShapeEntry {
+    BrainShape shape;
+    double (*quantError)(int bits, int agents, int ticks, double& bound);
+};
+
+//the arguments are expanded before they are pasted in, so the settings.h
+//shape gets its numbers for a name too
+#define SHAPE_NAME(n,c) #n "x" #c
+#define SHAPE_ENTRY(n,c) { {SHAPE_NAME(n,c), n, c}, quantError<n,c> },
+static const ShapeEntry SHAPES[]= { MLP_SHAPES(SHAPE_ENTRY) };
+
+double quantError(int bits, int agents, int ticks, double& bound)
+{
+    bound= 0;
+    return SHAPES[MLPBrain::shape()].quantError(bits, agents, ticks, bound);
+}
+
+int numBrainShapes()
+{
+    return sizeof(SHAPES)/sizeof(SHAPES[0]);
+}
+
+const BrainShape& brainShapeAt(int i)
+{
+    return SHAPES[i].shape;
+}
+
+int brainShapeByName(const char* name)
+{
+    for (int i=0;i<numBrainShapes();i++) {
+        if (strcmp(SHAPES[i].shape.name, name)==0) return i;
+    }
+    return -1;
+}
@@ -0,0 +1,31 @@
+#ifndef BRAINSHAPES_H
+#define BRAINSHAPES_H
+
+#include "settings.h"
+
+/**
+ * The shapes, <boxes>x<conns>, that the MLP kernels are instantiated for.
+ * One of them is picked at startup (MLPBrain::setShape, -shape) and every
+ * MLP brain of the run has it, so a bigger brain can be tried without
+ * editing settings.h. The first is the settings.h shape, and the default.
+ * MLPBrain, BrainArena and MLPNative each keep a table of their templates
+ * with one entry per shape, in this order.
+ */
+#define MLP_SHAPES(X) X(BRAINSIZE,CONNS) X(200,8) X(500,4) X(500,8)
+
+struct BrainShape {
+    const char* name; //"<boxes>x<conns>"
+    int boxes;
+    int conns;
+};
+
+int numBrainShapes();
+const BrainShape& brainShapeAt(int i);
+int brainShapeByName(const char* name); //index of the shape called that, -1 if none
+
+//largest difference in one tick between the outputs of agents random brains
+//of the current shape with bits-bit block weights (see MLPQBlockT) and with
+//float ones, over ticks ticks. bound gets the most it may be for them
+double quantError(int bits, int agents, int ticks, double& bound);
+
+#endif
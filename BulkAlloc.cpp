@@ -0,0 +1,103 @@
+#include "BulkAlloc.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+//every block starts with one cache line of bookkeeping, the caller gets what follows
+struct BlockHeader {
+    void* base; //what to hand back to free() or munmap()
+    size_t mapped; //length of the mapping, 0 if it came from aligned malloc
+};
+
+static bool HUGEPAGES= false;
+
+void setHugePages(bool on)
+{
+    HUGEPAGES= on;
+}
+
+bool hugePages()
+{
+    return HUGEPAGES;
+}
+
+static void* alignedMalloc(size_t bytes)
+{
+#ifdef _WIN32
+    return _aligned_malloc(bytes, CACHELINE);
+#else
+    void* p= NULL;
+    if (posix_memalign(&p, CACHELINE, bytes)!=0) return NULL;
+    return p;
+#endif
+}
+
+#ifdef __linux__
+//huge page backed mapping of len bytes (a multiple of HUGEPAGE), or NULL
+static void* mapHuge(size_t len)
+{
+    //explicit huge pages only exist if the admin reserved some (vm.nr_hugepages)
+#ifdef MAP_HUGETLB
+    void* p= mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if (p!=MAP_FAILED) return p;
+#endif
+
+    //otherwise ask for transparent huge pages. They need a HUGEPAGE aligned
+    //range, so map one extra and trim the ends
+    char* raw= (char*) mmap(NULL, len+HUGEPAGE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (raw==(char*) MAP_FAILED) return NULL;
+    char* p2= (char*) (((uintptr_t) raw + HUGEPAGE-1) & ~(uintptr_t) (HUGEPAGE-1));
+    if (p2>raw) munmap(raw, p2-raw);
+    char* end= raw+len+HUGEPAGE;
+    if (end>p2+len) munmap(p2+len, end-(p2+len));
+#ifdef MADV_HUGEPAGE
+    madvise(p2, len, MADV_HUGEPAGE);
+#endif
+    return p2;
+}
+#endif
+
+void* bulkAlloc(size_t bytes)
+{
+    size_t total= bytes+CACHELINE;
+    char* base= NULL;
+    size_t mapped= 0;
+
+#ifdef __linux__
+    if (HUGEPAGES && bytes>=HUGEPAGE) {
+        size_t len= (total+HUGEPAGE-1)/HUGEPAGE*HUGEPAGE;
+        base= (char*) mapHuge(len);
+        if (base!=NULL) mapped= len;
+    }
+#endif
+    if (base==NULL) base= (char*) alignedMalloc(total);
+    if (base==NULL) return NULL;
+
+    BlockHeader* h= (BlockHeader*) base;
+    h->base= base;
+    h->mapped= mapped;
+    return base+CACHELINE;
+}
+
+void bulkFree(void* p)
+{
+    if (p==NULL) return;
+    BlockHeader* h= (BlockHeader*) ((char*) p - CACHELINE);
+#ifdef __linux__
+    if (h->mapped>0) {
+        munmap(h->base, h->mapped);
+        return;
+    }
+#endif
+#ifdef _WIN32
+    _aligned_free(h->base);
+#else
+    free(h->base);
+#endif
+}
@@ -0,0 +1,49 @@
+#ifndef BULKALLOC_H
+#define BULKALLOC_H
+
+#include <stddef.h>
+#include <new>
+
+/**
+ * Allocation for the big simulation arrays (agents, brain arena, food).
+ * Every block is 64 byte aligned. With huge pages switched on, blocks of
+ * at least HUGEPAGE bytes are backed by explicit huge pages if the system
+ * has some reserved, or by transparent huge pages otherwise. Anything that
+ * fails falls back to plain aligned allocation.
+ */
+
+const size_t CACHELINE= 64;
+const size_t HUGEPAGE= 2*1024*1024;
+
+//runtime switch, off by default. Only affects blocks allocated afterwards
+void setHugePages(bool on);
+bool hugePages();
+
+void* bulkAlloc(size_t bytes);
+void bulkFree(void* p);
+
+//std allocator on top of bulkAlloc, for std::vector
+template <class T>
+class BulkAllocator
+{
+public:
+    typedef T value_type;
+
+    BulkAllocator() {}
+    template <class U> BulkAllocator(const BulkAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        void* p= bulkAlloc(n*sizeof(T));
+        if (p==NULL) throw std::bad_alloc();
+        return (T*) p;
+    }
+    void deallocate(T* p, size_t) { bulkFree(p); }
+};
+
+template <class T, class U>
+bool operator==(const BulkAllocator<T>&, const BulkAllocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const BulkAllocator<T>&, const BulkAllocator<U>&) { return false; }
+
+#endif
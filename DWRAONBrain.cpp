@@ -1,48 +1,38 @@
 #include "DWRAONBrain.h"
+#include "Simd.h"
 using namespace std;
 
+long DWRAONBrain::copies= 0;
+
 
 Box::Box()
 {
 
-    w.resize(CONNS,0);
-    id.resize(CONNS,0);
-    notted.resize(CONNS,0);
-
     //constructor
+    notted= 0;
     for (int i=0;i<CONNS;i++) {
         w[i]= randf(0.1,2);
         id[i]= randi(0,BRAINSIZE);
         if (randf(0,1)<0.2) id[i]= randi(0,INPUTSIZE); //20% of the brain AT LEAST should connect to input.
-        notted[i]= randf(0,1)<0.5;
+        if (randf(0,1)<0.5) notted|= 1<<i;
     }
 
     type= (randf(0,1)>0.5)?(0):(1);
     kp= randf(0.8,1);
     bias= randf(-1,1);
-
-    out=0;
-    target=0;
 }
 
-DWRAONBrain::DWRAONBrain()
+DWRAONBrain::DWRAONBrain() :
+        genome(std::make_shared<DWRAONGenome>())
 {
+    std::vector<Box>& boxes= genome->boxes;
 
     //constructor
     for (int i=0;i<BRAINSIZE;i++) {
         Box a; //make a random box and copy it over
         boxes.push_back(a);
 
-        boxes[i].out= a.out;
-        boxes[i].target= a.target;
-        boxes[i].type= a.type;
-        boxes[i].kp= a.kp;
-        boxes[i].bias= a.bias;
         for (int j=0;j<CONNS;j++) {
-            boxes[i].notted[j]= a.notted[j];
-            boxes[i].w[j]= a.w[j];
-            boxes[i].id[j]= a.id[j];
-
 //            if (randf(0,1)<0.05) boxes[i].id[j]=0;
 //            if (randf(0,1)<0.05) boxes[i].id[j]=5;
 //            if (randf(0,1)<0.05) boxes[i].id[j]=12;
@@ -56,147 +46,269 @@ DWRAONBrain::DWRAONBrain()
     }
 
     //do other initializations
-    init();
+    out.assign(BRAINSIZE, 0);
+    genome->compile();
 }
 
-DWRAONBrain::DWRAONBrain(const DWRAONBrain& other)
+DWRAONBrain::DWRAONBrain(const DWRAONBrain& other) :
+        genome(other.genome),
+        out(other.out)
+{
+    copies++;
+}
+
+DWRAONBrain::DWRAONBrain(DWRAONBrain&& other) noexcept :
+        genome(std::move(other.genome)),
+        out(std::move(other.out))
 {
-    boxes = other.boxes;
 }
 
 DWRAONBrain& DWRAONBrain::operator=(const DWRAONBrain& other)
 {
-    if( this != &other )
-        boxes = other.boxes;
+    if( this != &other ) {
+        genome = other.genome;
+        out = other.out;
+        copies++;
+    }
     return *this;
 }
 
+DWRAONBrain& DWRAONBrain::operator=(DWRAONBrain&& other) noexcept
+{
+    if( this != &other ) {
+        genome.swap(other.genome);
+        out.swap(other.out);
+    }
+    return *this;
+}
 
-void DWRAONBrain::init()
+DWRAONGenome& DWRAONBrain::own()
 {
+    if (genome.use_count()>1) genome= std::make_shared<DWRAONGenome>(*genome);
+    return *genome;
+}
 
+const std::vector<Box>& DWRAONBrain::boxes() const
+{
+    return genome->boxes;
 }
 
-void DWRAONBrain::tick(vector< float >& in, vector< float >& out)
+int DWRAONBrain::stateSize() const
 {
+    return BRAINSIZE;
+}
 
-    //do a single tick of the brain
+void DWRAONBrain::saveState(float* s) const
+{
+    for (int i=0;i<BRAINSIZE;i++) s[i]= out[i];
+}
 
-    //take first few boxes and set their out to in[].
-    for (int i=0;i<INPUTSIZE;i++) {
-        boxes[i].out= in[i];
+void DWRAONBrain::restoreState(const float* s)
+{
+    out.assign(s, s+BRAINSIZE);
+}
+
+void DWRAONGenome::compile()
+{
+    lanebox.resize(LANES);
+    laneid.resize(CONNS*LANES);
+    lanesign.resize(CONNS*LANES);
+    laneadd.resize(CONNS*LANES);
+    lanew.resize(CONNS*LANES);
+    lanebias.resize(LANES);
+    lanekp.resize(LANES);
+
+    int l= 0;
+    for (int t=0;t<2;t++) {
+        if (t==1) nand= l;
+        for (int i=INPUTSIZE;i<BRAINSIZE;i++) {
+            const Box& b= boxes[i];
+            if (b.type!=t) continue;
+            lanebox[l]= i;
+            for (int j=0;j<CONNS;j++) {
+                bool n= (b.notted>>j)&1;
+                laneid[j*LANES+l]= b.id[j];
+                lanesign[j*LANES+l]= n ? -1 : 1;
+                laneadd[j*LANES+l]= n ? 1 : -0.0f;
+                lanew[j*LANES+l]= b.w[j];
+            }
+            lanebias[l]= b.bias;
+            lanekp[l]= b.kp;
+            l++;
+        }
     }
+}
 
-    //then do a dynamics tick and set all targets
-    for (int i=INPUTSIZE;i<BRAINSIZE;i++) {
-        Box* abox= &boxes[i];
+size_t DWRAONGenome::memoryUsage(size_t& chunks) const
+{
+    size_t b[8]= {boxes.capacity()*sizeof(Box),
+                   lanebox.capacity()*sizeof(int), laneid.capacity()*sizeof(int),
+                   lanesign.capacity()*sizeof(float), laneadd.capacity()*sizeof(float), lanew.capacity()*sizeof(float),
+                   lanebias.capacity()*sizeof(float), lanekp.capacity()*sizeof(float)};
+    size_t payload= sizeof(DWRAONGenome);
+    chunks+= heapChunk(sizeof(DWRAONGenome)+2*sizeof(long)); //make_shared puts the counts in front
+    for (int k=0;k<8;k++) {
+        payload+= b[k];
+        chunks+= heapChunk(b[k]);
+    }
+    return payload;
+}
 
-        if (abox->type==0) {
+void DWRAONBrain::memoryUsage(size_t& payload, size_t& chunks) const
+{
+    size_t bytes= out.capacity()*sizeof(float);
+    payload+= bytes;
+    chunks+= heapChunk(bytes);
+    if (!genome) return;
+
+    size_t gchunks= 0;
+    size_t gpayload= genome->memoryUsage(gchunks);
+    payload+= gpayload/genome.use_count();
+    chunks+= gchunks/genome.use_count();
+}
 
-            //AND NODE
-            float res=1;
-            for (int j=0;j<CONNS;j++) {
-                int idx=abox->id[j];
-                float val= boxes[idx].out;
-                if (abox->notted[j]) val= 1-val;
-                //res= res * pow(val, abox->w[j]);
-                res= res * val;
-            }
-            res*= abox->bias;
-            abox->target= res;
+//a single tick of a brain with genome g and box outputs o
+static void tickKernel(const DWRAONGenome* genome, float* o, const float* in, float* out)
+{
+    const DWRAONGenome& g= *genome;
+    const int LANES= DWRAONGenome::LANES;
 
-        } else {
+    //take first few boxes and set their out to in[].
+    for (int i=0;i<INPUTSIZE;i++) {
+        o[i]= in[i];
+    }
 
-            //OR NODE
-            float res=0;
-            for (int j=0;j<CONNS;j++) {
-                int idx=abox->id[j];
-                float val= boxes[idx].out;
-                if (abox->notted[j]) val= 1-val;
-                res= res + val*abox->w[j];
-            }
-            res+= abox->bias;
-            abox->target= res;
+    //then do a dynamics tick and set all targets. Inputs in the same order
+    //as box by box, so the result is the same to the bit
+    float target[LANES];
+    const int nand= g.nand;
+    for (int l=0;l<nand;l++) target[l]= 1;
+    for (int l=nand;l<LANES;l++) target[l]= 0;
+    for (int j=0;j<CONNS;j++) {
+        const int* id= &g.laneid[j*LANES];
+        const float* sign= &g.lanesign[j*LANES];
+        const float* add= &g.laneadd[j*LANES];
+        const float* w= &g.lanew[j*LANES];
+
+        //AND NODES
+        #pragma omp simd
+        for (int l=0;l<nand;l++) {
+            float val= add[l] + sign[l]*o[id[l]];
+            target[l]= target[l] * val;
         }
 
-        //clamp target
-        if (abox->target<0) abox->target=0;
-        if (abox->target>1) abox->target=1;
+        //OR NODES
+        #pragma omp simd
+        for (int l=nand;l<LANES;l++) {
+            float val= add[l] + sign[l]*o[id[l]];
+            target[l]= target[l] + val*w[l];
+        }
+    }
+    for (int l=0;l<nand;l++) target[l]*= g.lanebias[l];
+    for (int l=nand;l<LANES;l++) target[l]+= g.lanebias[l];
+
+    //clamp target
+    #pragma omp simd
+    for (int l=0;l<LANES;l++) {
+        float t= target[l];
+        t= t<0 ? 0 : t;
+        t= t>1 ? 1 : t;
+        target[l]= t;
     }
 
     //make all boxes go a bit toward target
-    for (int i=INPUTSIZE;i<BRAINSIZE;i++) {
-        Box* abox= &boxes[i];
-        abox->out =abox->out + (abox->target-abox->out)*abox->kp;
+    for (int l=0;l<LANES;l++) {
+        float& v= o[g.lanebox[l]];
+        v= v + (target[l]-v)*g.lanekp[l];
     }
 
     //finally set out[] to the last few boxes output
     for (int i=0;i<OUTPUTSIZE;i++) {
-        out[i]= boxes[BRAINSIZE-1-i].out;
+        out[i]= o[BRAINSIZE-1-i];
     }
 }
 
-void DWRAONBrain::mutate(float MR, float MR2)
+void DWRAONBrain::tick(vector< float >& in, vector< float >& out)
 {
-    for (int j=0;j<BRAINSIZE;j++) {
-
-        if (randf(0,1)<MR*3) {
-            boxes[j].bias+= randn(0, MR2);
-//             a2.mutations.push_back("bias jiggled\n");
-        }
-
-        if (false && randf(0,1)<MR*3) {
-            boxes[j].kp+= randn(0, MR2);
-            if (boxes[j].kp<0.01) boxes[j].kp=0.01;
-            if (boxes[j].kp>1) boxes[j].kp=1;
-//             a2.mutations.push_back("kp jiggled\n");
-        }
+    SIMD_CALL(tickKernel, genome.get(), &this->out[0], &in[0], &out[0]);
+}
 
-        if (randf(0,1)<MR*3) {
-            int rc= randi(0, CONNS);
-            boxes[j].w[rc]+= randn(0, MR2);
-            if (boxes[j].w[rc]<0.01) boxes[j].w[rc]= 0.01;
-//             a2.mutations.push_back("weight jiggled\n");
+void DWRAONBrain::mutate(float MR, float MR2, MutationLog* log)
+{
+    //every box has 2 sites that mutate with probability MR*3 (bias, weight)
+    //and 3 that do with probability MR (connection, notted, type). Walk the
+    //two kinds of sites side by side, visiting only the ones that mutate, box
+    //by box in the same order as the changes are listed. Damper (kp)
+    //mutations are turned off
+    int fast= randskip(MR*3); //site box*2+k
+    int slow= randskip(MR); //site box*3+k
+    if (fast>=BRAINSIZE*2 && slow>=BRAINSIZE*3) return; //nothing changes, the genome stays shared
+
+    DWRAONGenome& g= own();
+    std::vector<Box>& boxes= g.boxes;
+    while (fast<BRAINSIZE*2 || slow<BRAINSIZE*3) {
+        if (fast/2<=slow/3) {
+            int j= fast/2;
+            if (fast%2==0) {
+                float old= boxes[j].bias;
+                boxes[j].bias+= randn(0, MR2);
+                if (log) log->record(Mutation::BIAS, j, 0, old, boxes[j].bias);
+            } else {
+                int rc= randi(0, CONNS);
+                float old= boxes[j].w[rc];
+                boxes[j].w[rc]+= randn(0, MR2);
+                if (boxes[j].w[rc]<0.01) boxes[j].w[rc]= 0.01;
+                if (log) log->record(Mutation::WEIGHT, j, rc, old, boxes[j].w[rc]);
+            }
+            fast+= 1+randskip(MR*3);
+            continue;
         }
 
         //more unlikely changes here
-        if (randf(0,1)<MR) {
+        int j= slow/3;
+        if (slow%3==0) {
             int rc= randi(0, CONNS);
             int ri= randi(0,BRAINSIZE);
+            int old= boxes[j].id[rc];
             boxes[j].id[rc]= ri;
-//             a2.mutations.push_back("connectivity changed\n");
-        }
-
-        if (randf(0,1)<MR) {
+            if (log) log->record(Mutation::CONNECTION, j, rc, old, ri);
+        } else if (slow%3==1) {
             int rc= randi(0, CONNS);
-            boxes[j].notted[rc]= !boxes[j].notted[rc];
-//             a2.mutations.push_back("notted was flipped\n");
-        }
-
-        if (randf(0,1)<MR) {
+            boxes[j].notted^= 1<<rc;
+            int n= (boxes[j].notted>>rc)&1;
+            if (log) log->record(Mutation::NOTTED, j, rc, 1-n, n);
+        } else {
             boxes[j].type= 1-boxes[j].type;
-//             a2.mutations.push_back("type of a box was changed\n");
+            if (log) log->record(Mutation::BOXTYPE, j, 0, 1-boxes[j].type, boxes[j].type);
         }
+        slow+= 1+randskip(MR);
     }
+    g.compile();
 }
 
 DWRAONBrain DWRAONBrain::crossover(const DWRAONBrain& other)
 {
     //this could be made faster by returning a pointer
     //instead of returning by value
+    //every field is inherited on its own, so this is a coin flip per field
+    //rather than copies of whole boxes. The flips come 64 to a rand() batch
     DWRAONBrain newbrain(*this);
-    
-    for (int i=0;i<newbrain.boxes.size(); i++) {
-        newbrain.boxes[i].bias= randf(0,1)<0.5 ? this->boxes[i].bias : other.boxes[i].bias;
-        newbrain.boxes[i].kp= randf(0,1)<0.5 ? this->boxes[i].kp : other.boxes[i].kp;
-        newbrain.boxes[i].type= randf(0,1)<0.5 ? this->boxes[i].type : other.boxes[i].type;
-
-        for (int j=0;j<newbrain.boxes[i].id.size();j++) {
-            newbrain.boxes[i].id[j] = randf(0,1)<0.5 ? this->boxes[i].id[j] : other.boxes[i].id[j];
-            newbrain.boxes[i].notted[j] = randf(0,1)<0.5 ? this->boxes[i].notted[j] : other.boxes[i].notted[j];
-            newbrain.boxes[i].w[j] = randf(0,1)<0.5 ? this->boxes[i].w[j] : other.boxes[i].w[j];
+    DWRAONGenome& g= newbrain.own();
+    RandBits coin;
+    for (int i=0;i<g.boxes.size(); i++) {
+        Box& nb= g.boxes[i];
+        const Box& ob= other.genome->boxes[i];
+        if (!coin.next()) nb.bias= ob.bias;
+        if (!coin.next()) nb.kp= ob.kp;
+        if (!coin.next()) nb.type= ob.type;
+
+        for (int j=0;j<CONNS;j++) {
+            if (!coin.next()) nb.id[j]= ob.id[j];
+            if (!coin.next()) nb.notted= (nb.notted & ~(1<<j)) | (ob.notted & (1<<j));
+            if (!coin.next()) nb.w[j]= ob.w[j];
         }
     }
+    g.compile();
     return newbrain;
 }
 
@@ -3,9 +3,12 @@
 
 #include "settings.h"
 #include "helpers.h"
+#include "MutationLog.h"
 
 #include <vector>
+#include <memory>
 
+static_assert(CONNS<=8, "notted inputs are kept as a bitmask in a byte, CONNS must be at most 8");
 
 class Box {
 public:
@@ -15,35 +18,73 @@ public:
     //props
     int type; //0: AND, 1:OR
     float kp; //kp: damping strength
-    std::vector<float> w; //weight of each connecting box (in [0,inf]
-    std::vector<int> id; //id in boxes[] of the connecting box
-    std::vector<bool> notted; //is this input notted before coming in?
+    float w[CONNS]; //weight of each connecting box (in [0,inf]
+    int id[CONNS]; //id in boxes[] of the connecting box
+    unsigned char notted; //bit j set: input j is notted before coming in
     float bias;
+};
 
-    //state variables
-    float target; //target value this node is going toward
-    float out; //current output, and history. 0 is farthest back. -1 is latest
+//the heritable part of a DWRAONBrain: boxes[], and the copy of it that
+//compile() lays out for the kernel. It only changes on mutate and crossover,
+//and brains that have the same one share it
+struct DWRAONGenome {
+    std::vector<Box> boxes;
 
+    static const int LANES= BRAINSIZE-INPUTSIZE;
+    int nand; //lanes 0..nand-1 are AND boxes, the rest OR boxes
+    std::vector<int> lanebox; //box of each lane
+    std::vector<int> laneid; //[j*LANES+l]: input j of lane l, and so on
+    std::vector<float> lanesign; //-1 if notted, else 1
+    std::vector<float> laneadd; //1 if notted, else -0
+    std::vector<float> lanew;
+    std::vector<float> lanebias;
+    std::vector<float> lanekp;
 
+    void compile(); //lay boxes[] out for tick(), after it changed
+    size_t memoryUsage(size_t& chunks) const; //heap bytes, and what malloc takes for them added to chunks
 };
+
 /**
  * Damped Weighted Recurrent AND/OR Network
+ * The genome is boxes[]. tick() runs from a copy of it that compile() lays
+ * out for the kernel: the computed boxes grouped by type, ANDs first, one
+ * lane each, with every per-input value stored input by input across the
+ * lanes. A notted input is 1-v= 1+(-1)*v and a plain one -0+1*v, so each
+ * type is one branch-free loop the compiler can vectorize.
+ * Both sit in a DWRAONGenome that copies of a brain share until one of them
+ * mutates. The state of a brain is only the output of each box.
  */
 class DWRAONBrain
 {
 public:
 
-    std::vector<Box> boxes;
-
     DWRAONBrain();
     DWRAONBrain(const DWRAONBrain &other);
+    DWRAONBrain(DWRAONBrain &&other) noexcept;
     virtual DWRAONBrain& operator=(const DWRAONBrain& other);
+    virtual DWRAONBrain& operator=(DWRAONBrain&& other) noexcept;
 
     void tick(std::vector<float>& in, std::vector<float>& out);
-    void mutate(float MR, float MR2);
+    void mutate(float MR, float MR2, MutationLog* log= NULL); //log, if given, records every mutation
     DWRAONBrain crossover( const DWRAONBrain &other );
+
+    const std::vector<Box>& boxes() const;
+
+    //the state, out of the genome: stateSize() floats written to or read from s
+    int stateSize() const;
+    void saveState(float* s) const;
+    void restoreState(const float* s);
+
+    //adds the heap bytes this brain owns to payload, and what malloc really takes
+    //for them to chunks. A shared genome counts for this brain's share
+    void memoryUsage(size_t& payload, size_t& chunks) const;
+
+    static long copies; //number of copies made so far. Moves don't count
 private:
-    void init();
+    DWRAONGenome& own(); //the genome, copied first if another brain has it too
+
+    std::shared_ptr<DWRAONGenome> genome;
+    std::vector<float> out; //current output of each box
 };
 
 #endif
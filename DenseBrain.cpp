@@ -0,0 +1,233 @@
+#include "DenseBrain.h"
+#include "Sigmoid.h"
+#include "Simd.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+using namespace std;
+
+long DenseBrain::copies= 0;
+
+static const int H= DenseGenome::H;
+static const int COLS= DenseGenome::COLS;
+static const int SITES= sizeof(DenseGenome)/sizeof(float); //weights and biases
+static_assert(sizeof(DenseGenome)==SITES*sizeof(float), "DenseGenome has to be floats only");
+
+DenseBrain::DenseBrain() :
+        genome(std::make_shared<DenseGenome>()),
+        hidden(H, 0)
+{
+    //weights scaled to the number of inputs of a unit, so that its sum
+    //stays in the range where the sigmoid is not flat
+    DenseGenome& g= *genome;
+    float sh= 3/sqrt((float) COLS);
+    float so= 3/sqrt((float) H);
+    for (int r=0;r<H;r++) {
+        for (int c=0;c<COLS;c++) g.wh[r][c]= randf(-sh, sh);
+        g.bh[r]= randf(-1, 1);
+    }
+    for (int o=0;o<OUTPUTSIZE;o++) {
+        for (int c=0;c<H;c++) g.wo[o][c]= randf(-so, so);
+        g.bo[o]= randf(-1, 1);
+    }
+}
+
+DenseBrain::DenseBrain(const DenseBrain& other) :
+        genome(other.genome),
+        hidden(other.hidden)
+{
+    copies++;
+}
+
+DenseBrain::DenseBrain(DenseBrain&& other) noexcept :
+        genome(std::move(other.genome)),
+        hidden(std::move(other.hidden))
+{
+}
+
+DenseBrain& DenseBrain::operator=(const DenseBrain& other)
+{
+    if( this != &other ) {
+        genome = other.genome;
+        hidden = other.hidden;
+        copies++;
+    }
+    return *this;
+}
+
+DenseBrain& DenseBrain::operator=(DenseBrain&& other) noexcept
+{
+    if( this != &other ) {
+        genome.swap(other.genome);
+        hidden.swap(other.hidden);
+    }
+    return *this;
+}
+
+DenseGenome& DenseBrain::own()
+{
+    if (genome.use_count()>1) genome= std::make_shared<DenseGenome>(*genome);
+    return *genome;
+}
+
+int DenseBrain::stateSize() const
+{
+    return H;
+}
+
+void DenseBrain::saveState(float* s) const
+{
+    memcpy(s, &hidden[0], H*sizeof(float));
+}
+
+void DenseBrain::restoreState(const float* s)
+{
+    hidden.assign(s, s+H);
+}
+
+void DenseBrain::memoryUsage(size_t& payload, size_t& chunks) const
+{
+    size_t bytes= hidden.capacity()*sizeof(float);
+    payload+= bytes;
+    chunks+= heapChunk(bytes);
+    if (!genome) return;
+
+    //make_shared puts the counts in front of the genome
+    payload+= sizeof(DenseGenome)/genome.use_count();
+    chunks+= heapChunk(sizeof(DenseGenome)+2*sizeof(long))/genome.use_count();
+}
+
+static inline float dot(const float* a, const float* b, int n)
+{
+    float acc= 0;
+    #pragma omp simd reduction(+:acc)
+    for (int k=0;k<n;k++) acc+= a[k]*b[k];
+    return acc;
+}
+
+void DenseBrain::tickTile(const DenseGenome* genome, DenseBrain* const* brains, vector<float>* const* in, vector<float>* const* out, int n)
+{
+    const DenseGenome& g= *genome;
+    //inputs and last hidden layer of each brain of the tile, one row each
+    float x[DENSETILE][COLS];
+    float h[DENSETILE][H];
+    for (int j=0;j<n;j++) {
+        memcpy(x[j], &(*in[j])[0], INPUTSIZE*sizeof(float));
+        memcpy(x[j]+INPUTSIZE, &brains[j]->hidden[0], H*sizeof(float));
+    }
+
+    //hidden layer. Each row of weights goes over every brain of the tile
+    //while it is in cache
+    for (int r=0;r<H;r++) {
+        for (int j=0;j<n;j++) h[j][r]= dot(g.wh[r], x[j], COLS) + g.bh[r];
+    }
+    for (int j=0;j<n;j++) {
+        sigmoidArray(sigmoidKind(), h[j], H);
+        memcpy(&brains[j]->hidden[0], h[j], H*sizeof(float));
+    }
+
+    //then the outputs from it
+    for (int o=0;o<OUTPUTSIZE;o++) {
+        for (int j=0;j<n;j++) (*out[j])[o]= dot(g.wo[o], h[j], H) + g.bo[o];
+    }
+    for (int j=0;j<n;j++) sigmoidArray(sigmoidKind(), &(*out[j])[0], OUTPUTSIZE);
+}
+
+void DenseBrain::tick(vector< float >& in, vector< float >& out)
+{
+    DenseBrain* self= this;
+    vector<float>* i= &in;
+    vector<float>* o= &out;
+    SIMD_CALL(tickTile, genome.get(), &self, &i, &o, 1);
+}
+
+void DenseBrain::tickAll(DenseBrain* const* brains, vector<float>* const* in, vector<float>* const* out, int n)
+{
+    //brains with the same genome next to each other, cut into tiles
+    vector< pair<size_t,int> > bygenome(n);
+    for (int k=0;k<n;k++) bygenome[k]= make_pair((size_t) brains[k]->genome.get(), k);
+    std::sort(bygenome.begin(), bygenome.end());
+    vector<int> order(n);
+    for (int k=0;k<n;k++) order[k]= bygenome[k].second;
+
+    vector<int> tiles; //where each tile starts in order[], and n at the end
+    for (int k=0;k<n;) {
+        size_t g= bygenome[k].first;
+        tiles.push_back(k);
+        int end= min(k+DENSETILE, n);
+        for (k++; k<end && bygenome[k].first==g; k++) {}
+    }
+    tiles.push_back(n);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int t=0;t<(int) tiles.size()-1;t++) {
+        int first= tiles[t], m= tiles[t+1]-first;
+        DenseBrain* b[DENSETILE];
+        vector<float>* i[DENSETILE];
+        vector<float>* o[DENSETILE];
+        for (int j=0;j<m;j++) {
+            b[j]= brains[order[first+j]];
+            i[j]= in[order[first+j]];
+            o[j]= out[order[first+j]];
+        }
+        SIMD_CALL(tickTile, b[0]->genome.get(), b, i, o, m);
+    }
+}
+
+//log the mutation of float s of a DenseGenome. The hidden units are boxes
+//0..H-1, the outputs come after them, and conn is the column of a weight
+static void logSite(MutationLog* log, int s, float old, float now)
+{
+    if (s<H*COLS) {
+        log->record(Mutation::WEIGHT, s/COLS, s%COLS, old, now);
+        return;
+    }
+    s-= H*COLS;
+    if (s<H) {
+        log->record(Mutation::BIAS, s, 0, old, now);
+        return;
+    }
+    s-= H;
+    if (s<OUTPUTSIZE*H) {
+        log->record(Mutation::WEIGHT, H+s/H, s%H, old, now);
+        return;
+    }
+    s-= OUTPUTSIZE*H;
+    log->record(Mutation::BIAS, H+s, 0, old, now);
+}
+
+void DenseBrain::mutate(float MR, float MR2, MutationLog* log)
+{
+    //every weight and bias mutates with probability MR. Visit only the ones that do
+    int s= randskip(MR);
+    if (s>=SITES) return; //nothing changes, the genome stays shared
+
+    float* p= &own().wh[0][0];
+    for (; s<SITES; s+= 1+randskip(MR)) {
+        float old= p[s];
+        p[s]+= randn(0, MR2);
+        if (log) logSite(log, s, old, p[s]);
+    }
+}
+
+DenseBrain DenseBrain::crossover(const DenseBrain& other)
+{
+    //child starts as a copy of this brain (state included), then every unit
+    //comes from other on a coin flip, with its incoming weights and bias
+    DenseBrain newbrain(*this);
+    DenseGenome& g= newbrain.own();
+    const DenseGenome& og= *other.genome;
+    RandBits coin;
+    for (int r=0;r<H;r++) {
+        if (coin.next()) continue;
+        memcpy(g.wh[r], og.wh[r], sizeof(g.wh[r]));
+        g.bh[r]= og.bh[r];
+    }
+    for (int o=0;o<OUTPUTSIZE;o++) {
+        if (coin.next()) continue;
+        memcpy(g.wo[o], og.wo[o], sizeof(g.wo[o]));
+        g.bo[o]= og.bo[o];
+    }
+    return newbrain;
+}
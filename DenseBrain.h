@@ -0,0 +1,76 @@
+#ifndef DENSEBRAIN_H
+#define DENSEBRAIN_H
+
+#include "settings.h"
+#include "helpers.h"
+#include "MutationLog.h"
+
+#include <vector>
+#include <memory>
+
+static_assert(INPUTSIZE+DENSEHIDDEN<=256, "mutation records keep the column of a weight in a byte");
+
+//the heritable part of a DenseBrain, all floats. Row r of wh weighs the
+//inputs and then the hidden units of the tick before into hidden unit r,
+//row o of wo weighs the hidden units into output o
+struct DenseGenome {
+    static const int H= DENSEHIDDEN;
+    static const int COLS= INPUTSIZE+DENSEHIDDEN;
+
+    float wh[H][COLS];
+    float bh[H];
+    float wo[OUTPUTSIZE][H];
+    float bo[OUTPUTSIZE];
+};
+
+/**
+ * Layered recurrent network: the inputs and the DENSEHIDDEN hidden units of
+ * the tick before feed the hidden layer, which feeds the outputs. All units
+ * are sigmoids with a weight from every unit of the layer below, so a tick
+ * is two dense matrix-vector products and the cost grows with DENSEHIDDEN
+ * squared rather than with random wiring.
+ * The genome is shared by copies of a brain until one of them mutates, as
+ * with DWRAONBrain. The state of a brain is its hidden layer.
+ * tickAll() runs a whole population. Brains that share a genome are done
+ * together as one matrix product, tiles of DENSETILE of them at a time, so
+ * each row of weights is read once for the tile while it sits in cache.
+ */
+class DenseBrain
+{
+public:
+
+    DenseBrain();
+    DenseBrain(const DenseBrain &other);
+    DenseBrain(DenseBrain &&other) noexcept;
+    virtual DenseBrain& operator=(const DenseBrain& other);
+    virtual DenseBrain& operator=(DenseBrain&& other) noexcept;
+
+    void tick(std::vector<float>& in, std::vector<float>& out);
+    void mutate(float MR, float MR2, MutationLog* log= NULL); //log, if given, records every mutation
+    DenseBrain crossover( const DenseBrain &other );
+
+    //the state, stateSize() floats written to or read from s: the hidden layer
+    int stateSize() const;
+    void saveState(float* s) const;
+    void restoreState(const float* s);
+
+    //adds the heap bytes this brain owns to payload, and what malloc really takes
+    //for them to chunks. A shared genome counts for this brain's share
+    void memoryUsage(size_t& payload, size_t& chunks) const;
+
+    //tick brains[k] from in[k] into out[k], for k<n, in parallel. Gives
+    //exactly the same results as calling tick() on each of them
+    static void tickAll(DenseBrain* const* brains, std::vector<float>* const* in, std::vector<float>* const* out, int n);
+
+    static const int DENSETILE= 8; //brains per tile of a matrix product
+
+    static long copies; //number of copies made so far. Moves don't count
+private:
+    DenseGenome& own(); //the genome, copied first if another brain has it too
+    static void tickTile(const DenseGenome* genome, DenseBrain* const* brains, std::vector<float>* const* in, std::vector<float>* const* out, int n);
+
+    std::shared_ptr<DenseGenome> genome;
+    std::vector<float> hidden; //hidden layer after the last tick
+};
+
+#endif
@@ -157,6 +157,8 @@ void GLView::processNormalKeys(unsigned char key, int x, int y)
     } else if (key=='s') {
         if(following==0) following=2;
         else following=0;
+    } else if (key=='m') {
+        world->printMemoryReport();
     } else if(key =='o') {
         if(following==0) following = 1; //follow oldest agent: toggle
         else following =0;
@@ -267,12 +269,13 @@ void GLView::drawAgent(const Agent& agent)
         yy+=ss*2;
 
         //draw brain. Eventually move this to brain class?
+        //only MLP brains run in the arena, where their outputs can be read
         
         float offx=0;
         ss=8;
         xx=ss;
-        for (int j=0;j<BRAINSIZE;j++) {
-            col = agent.brain.boxes[j].out;
+        for (int j=0;j<MLPBrain::boxes() && agent.brainslot!=-1;j++) {
+            col = world->brainArena().out(agent.brainslot, j);
             glColor3f(col,col,col);
             
             glVertex3f(offx+0+ss*j, yy, 0.0f);
@@ -295,7 +298,7 @@ void GLView::drawAgent(const Agent& agent)
         xx=ss;
         for (int j=0;j<BRAINSIZE;j++) {
             for(int k=0;k<CONNS;k++){
-                int j2= agent.brain.boxes[j].id[k];
+                int j2= agent.brain.mlp().source(j,k);
                 
                 //project indices j and j2 into pixel space
                 float x1= 0;
@@ -314,7 +317,7 @@ void GLView::drawAgent(const Agent& agent)
                     y2= yy+ss+2*ss*((int) (j2-INPUTSIZE)/30);
                 }
                 
-                float ww= agent.brain.boxes[j].w[k];
+                float ww= agent.brain.mlp().weight(j,k);
                 if(ww<0) glColor3f(-ww, 0, 0);
                 else glColor3f(0,0,ww);
                 
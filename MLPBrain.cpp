@@ -1,207 +1,541 @@
 #include "MLPBrain.h"
+#include "BrainShapes.h"
+#include "BulkAlloc.h"
+
+#include <string.h>
+#include <algorithm>
 using namespace std;
 
+long MLPBrain::copies= 0;
+long long MLPBrain::bytescopied= 0;
+
+static long livechunks= 0; //genome chunks allocated
+static long chunkrefs= 0; //brains pointing to them, summed over the chunks
 
-MLPBox::MLPBox()
+static void* allocBlock(size_t bytes)
 {
+    void* p= bulkAlloc(bytes);
+    if (p==NULL) throw std::bad_alloc();
+    return p;
+}
 
-    w.resize(CONNS,0);
-    id.resize(CONNS,0);
-    type.resize(CONNS,0);
+//chunks come and go a dozen at a time with every birth and death, so freed
+//ones are kept for reuse rather than given back to malloc. The pool owns
+//them and gives them back at exit, or when the shape changes
+struct SpareChunks {
+    std::vector<MLPChunk*> list;
+    bool gone; //destroyed, brains freed later by other statics skip the pool
 
-    //constructor
-    for (int i=0;i<CONNS;i++) {
-        w[i]= randf(-3,3);
-        if(randf(0,1)<0.5) w[i]=0; //make brains sparse
-        
-        id[i]= randi(0,BRAINSIZE);
-        if (randf(0,1)<0.2) id[i]= randi(0,INPUTSIZE); //20% of the brain AT LEAST should connect to input.
-        
-        type[i] = 0;
-        if(randf(0,1)<0.05) type[i] = 1; //make 5% be change sensitive synapses
+    SpareChunks() : gone(false) {}
+    ~SpareChunks()
+    {
+        flush();
+        gone= true;
     }
+    void flush()
+    {
+        for (size_t i=0;i<list.size();i++) bulkFree(list[i]);
+        list.clear();
+    }
+};
+static SpareChunks sparechunks;
+const size_t MAXSPARECHUNKS= 4096;
+
+static MLPChunk* allocChunk()
+{
+    if (sparechunks.list.empty()) return (MLPChunk*) allocBlock(MLPBrain::chunkBytes());
+    MLPChunk* k= sparechunks.list.back();
+    sparechunks.list.pop_back();
+    return k;
+}
+
+static void freeChunk(MLPChunk* k)
+{
+    if (!sparechunks.gone && sparechunks.list.size()<MAXSPARECHUNKS) sparechunks.list.push_back(k);
+    else bulkFree(k);
+}
 
-    kp=randf(0.9,1.1);
-    gw= randf(0,5);
-    bias= randf(-2,2);
+static MLPChunk* newChunk()
+{
+    MLPChunk* k= allocChunk();
+    memset(k, 0, MLPBrain::chunkBytes());
+    k->refs= 1;
+    livechunks++;
+    chunkrefs++;
+    return k;
+}
 
-    out=0;
-    oldout=0;
-    target=0;
+static void unref(MLPChunk* k)
+{
+    if (k==NULL) return;
+    chunkrefs--;
+    if (--k->refs>0) return;
+    freeChunk(k);
+    livechunks--;
 }
 
-MLPBrain::MLPBrain()
+void MLPBrain::chunkStats(long& chunks, long& refs)
 {
+    chunks= livechunks;
+    refs= chunkrefs;
+}
+
+const int MAXCHUNKBOXES= 32; //boxes per genome chunk, in the biggest shape
+
+/**
+ * The parts of MLPBrain that depend on its shape, N boxes with C synapses
+ * each, and the chunk and state layouts of that shape
+ */
+template <int N, int C>
+struct MLPShape {
+    typedef MLPBoxesT<N,C> Boxes;
+    enum {
+        CHUNK= N<=256 ? 16 : 32, //boxes per genome chunk
+        CHUNKS= (N+CHUNK-1)/CHUNK
+    };
+    static_assert(CHUNKS<=MLPMAXCHUNKS && CHUNK<=MAXCHUNKBOXES, "raise MLPMAXCHUNKS for this shape");
+
+    struct Chunk : MLPChunk {
+        float w[CHUNK*C];
+        float kp[CHUNK];
+        float gw[CHUNK];
+        float bias[CHUNK];
+        typename Boxes::BoxId id[CHUNK*C];
+        unsigned char type[CHUNK];
+    };
+
+    struct State : MLPState {
+        float target[N];
+        float out[2][N];
+        unsigned char cur;
+    };
+
+    static Chunk* chunk(const MLPBrain& m, int c) { return static_cast<Chunk*>(m.chunk[c]); }
+    static State* state(const MLPBrain& m) { return static_cast<State*>(m.state); }
+
+    //number of boxes in chunk c. The last one may not be full
+    static int boxesIn(int c)
+    {
+        return min((int) CHUNK, N-c*CHUNK);
+    }
+
+    static void randomize(MLPBrain& m)
+    {
+        //randomize flat, then split up into chunks
+        Boxes b;
+        mlpRandomize<N,C,INPUTSIZE>(b);
+        load(m, (const char*) &b);
+    }
+
+    static void load(MLPBrain& m, const char* p)
+    {
+        const Boxes& b= *(const Boxes*) p;
+        for (int c=0;c<CHUNKS;c++) {
+            unref(m.chunk[c]);
+            Chunk* k= static_cast<Chunk*>(newChunk());
+            int first= c*CHUNK, n= boxesIn(c);
+            memcpy(k->w, &b.w[first*C], n*C*sizeof(float));
+            memcpy(k->kp, &b.kp[first], n*sizeof(float));
+            memcpy(k->gw, &b.gw[first], n*sizeof(float));
+            memcpy(k->bias, &b.bias[first], n*sizeof(float));
+            memcpy(k->id, &b.id[first*C], n*C*sizeof(k->id[0]));
+            memcpy(k->type, &b.type[first], n*sizeof(k->type[0]));
+            m.chunk[c]= k;
+        }
+        if (m.state==NULL) m.state= (State*) allocBlock(sizeof(State));
+        loadState(m, p);
+    }
+
+    static void loadState(MLPBrain& m, const char* p)
+    {
+        const Boxes& b= *(const Boxes*) p;
+        State* s= state(m);
+        memcpy(s->target, b.target, sizeof(s->target));
+        memcpy(s->out, b.out, sizeof(s->out));
+        s->cur= b.cur;
+    }
+
+    static void store(const MLPBrain& m, char* p)
+    {
+        Boxes& b= *(Boxes*) p;
+        for (int c=0;c<CHUNKS;c++) {
+            const Chunk* k= chunk(m, c);
+            int first= c*CHUNK, n= boxesIn(c);
+            memcpy(&b.w[first*C], k->w, n*C*sizeof(float));
+            memcpy(&b.kp[first], k->kp, n*sizeof(float));
+            memcpy(&b.gw[first], k->gw, n*sizeof(float));
+            memcpy(&b.bias[first], k->bias, n*sizeof(float));
+            memcpy(&b.id[first*C], k->id, n*C*sizeof(k->id[0]));
+            memcpy(&b.type[first], k->type, n*sizeof(k->type[0]));
+        }
+        const State* s= state(m);
+        memcpy(b.target, s->target, sizeof(b.target));
+        memcpy(b.out, s->out, sizeof(b.out));
+        b.cur= s->cur;
+    }
+
+    static void saveState(const MLPBrain& m, float* f)
+    {
+        mlpSaveState<N>(state(m)->out, state(m)->cur, f);
+    }
+
+    static void restoreState(MLPBrain& m, const float* f)
+    {
+        mlpRestoreState<N>(f, state(m)->out, state(m)->cur);
+    }
 
-    //constructor
-    for (int i=0;i<BRAINSIZE;i++) {
-        MLPBox a; //make a random box and copy it over
-        boxes.push_back(a);
-        
-        /*
-        boxes[i].out= a.out;
-        boxes[i].oldout = a.oldout;
-        boxes[i].target= a.target;
-        boxes[i].kp= a.kp;
-        boxes[i].gw= a.gw;
-        boxes[i].bias= a.bias;
-        for (int j=0;j<CONNS;j++) {
-            boxes[i].w[j]= a.w[j];
-            boxes[i].id[j]= a.id[j];
-            boxes[i].type[j] = a.type[j];
-            if (i<BRAINSIZE/2) {
-                boxes[i].id[j]= randi(0,INPUTSIZE);
+    static float weight(const MLPBrain& m, int box, int conn)
+    {
+        return chunk(m, box/CHUNK)->w[(box%CHUNK)*C+conn];
+    }
+
+    static int source(const MLPBrain& m, int box, int conn)
+    {
+        return chunk(m, box/CHUNK)->id[(box%CHUNK)*C+conn];
+    }
+
+    static void tick(char* p, const float* in, float* out)
+    {
+        mlpTick<N,C,INPUTSIZE,OUTPUTSIZE>(*(Boxes*) p, in, out);
+    }
+
+    static void tickOwn(MLPBrain& m, const float* in, float* out)
+    {
+        //the World ticks its brains flat in a BrainArena. This one is put
+        //together flat for the tick, and takes the state back after
+        Boxes b;
+        store(m, (char*) &b);
+        tick((char*) &b, in, out);
+        loadState(m, (const char*) &b);
+    }
+
+    static void mutate(MLPBrain& m, float MR, float MR2, MutationLog* log)
+    {
+        //every box has 6 sites, one per kind of change below, that each mutate
+        //with probability MR. Visit only the ones that do, in the same order
+        const int KINDS= 6;
+        for (int s=randskip(MR); s<N*KINDS; s+= 1+randskip(MR)) {
+            int j= s/KINDS;
+            Chunk* b= static_cast<Chunk*>(m.own(j/CHUNK)); //write a chunk of our own, not one shared
+            int i= j%CHUNK;
+            switch (s%KINDS) {
+            case 0: {
+                float old= b->bias[i];
+                b->bias[i]+= randn(0, MR2);
+                if (log) log->record(Mutation::BIAS, j, 0, old, b->bias[i]);
+                break;
+            }
+            case 1: {
+                float old= b->kp[i];
+                b->kp[i]+= randn(0, MR2);
+                if (b->kp[i]<0.01) b->kp[i]=0.01;
+                if (b->kp[i]>1) b->kp[i]=1;
+                if (log) log->record(Mutation::KP, j, 0, old, b->kp[i]);
+                break;
+            }
+            case 2: {
+                float old= b->gw[i];
+                b->gw[i]+= randn(0, MR2);
+                if (b->gw[i]<0) b->gw[i]=0;
+                if (log) log->record(Mutation::GW, j, 0, old, b->gw[i]);
+                break;
+            }
+            case 3: {
+                int rc= randi(0, C);
+                float old= b->w[i*C+rc];
+                b->w[i*C+rc]+= randn(0, MR2);
+                if (log) log->record(Mutation::WEIGHT, j, rc, old, b->w[i*C+rc]);
+                break;
+            }
+            case 4: {
+                int rc= randi(0, C);
+                b->type[i]^= 1<<rc; //flip type of synapse
+                int t= (b->type[i]>>rc)&1;
+                if (log) log->record(Mutation::SYNAPSETYPE, j, rc, 1-t, t);
+                break;
+            }
+            default: {
+                //more unlikely changes here
+                int rc= randi(0, C);
+                int ri= randi(0,N);
+                int old= b->id[i*C+rc];
+                b->id[i*C+rc]= ri;
+                if (log) log->record(Mutation::CONNECTION, j, rc, old, ri);
+            }
             }
         }
-        */
     }
 
-    //do other initializations
-    init();
+    //copy boxes [a,b) of chunk from over those of to
+    static void copyBoxes(MLPChunk* t, const MLPChunk* f, int a, int b)
+    {
+        Chunk* to= static_cast<Chunk*>(t);
+        const Chunk* from= static_cast<const Chunk*>(f);
+        int n= b-a;
+        memcpy(&to->bias[a], &from->bias[a], n*sizeof(float));
+        memcpy(&to->gw[a], &from->gw[a], n*sizeof(float));
+        memcpy(&to->kp[a], &from->kp[a], n*sizeof(float));
+        memcpy(&to->type[a], &from->type[a], n*sizeof(to->type[0]));
+        memcpy(&to->id[a*C], &from->id[a*C], n*C*sizeof(to->id[0]));
+        memcpy(&to->w[a*C], &from->w[a*C], n*C*sizeof(float));
+        MLPBrain::bytescopied+= n*(3*sizeof(float)+sizeof(to->type[0])+C*(sizeof(to->id[0])+sizeof(float)));
+    }
+};
+
+//MLPShape of every shape of BrainShapes.h, in that order
+struct ShapeOps {
+    int boxes, conns;
+    int chunks, chunkboxes;
+    size_t chunkbytes, statebytes;
+    void (*randomize)(MLPBrain& m);
+    void (*load)(MLPBrain& m, const char* p);
+    void (*loadState)(MLPBrain& m, const char* p);
+    void (*store)(const MLPBrain& m, char* p);
+    void (*saveState)(const MLPBrain& m, float* f);
+    void (*restoreState)(MLPBrain& m, const float* f);
+    float (*weight)(const MLPBrain& m, int box, int conn);
+    int (*source)(const MLPBrain& m, int box, int conn);
+    void (*tick)(char* p, const float* in, float* out);
+    void (*tickOwn)(MLPBrain& m, const float* in, float* out);
+    void (*mutate)(MLPBrain& m, float MR, float MR2, MutationLog* log);
+    void (*copyBoxes)(MLPChunk* to, const MLPChunk* from, int a, int b);
+};
+
+#define SHAPE_OPS(n,c) { n, c, MLPShape<n,c>::CHUNKS, MLPShape<n,c>::CHUNK, \
+        sizeof(MLPShape<n,c>::Chunk), sizeof(MLPShape<n,c>::State), \
+        MLPShape<n,c>::randomize, MLPShape<n,c>::load, MLPShape<n,c>::loadState, MLPShape<n,c>::store, \
+        MLPShape<n,c>::saveState, MLPShape<n,c>::restoreState, MLPShape<n,c>::weight, MLPShape<n,c>::source, \
+        MLPShape<n,c>::tick, MLPShape<n,c>::tickOwn, MLPShape<n,c>::mutate, MLPShape<n,c>::copyBoxes },
+static const ShapeOps SHAPES[]= { MLP_SHAPES(SHAPE_OPS) };
+static int SHAPE= 0;
+
+bool MLPBrain::setShape(int i)
+{
+    if (i<0 || i>=(int) (sizeof(SHAPES)/sizeof(SHAPES[0]))) return false;
+    if (i==SHAPE) return true;
+    if (livechunks>0) return false;
+    sparechunks.flush(); //they are the size of the old shape's
+    SHAPE= i;
+    return true;
 }
 
-MLPBrain::MLPBrain(const MLPBrain& other)
+int MLPBrain::shape()
 {
-    boxes = other.boxes;
+    return SHAPE;
 }
 
-MLPBrain& MLPBrain::operator=(const MLPBrain& other)
+int MLPBrain::boxes()
 {
-    if( this != &other )
-        boxes = other.boxes;
-    return *this;
+    return SHAPES[SHAPE].boxes;
 }
 
+int MLPBrain::conns()
+{
+    return SHAPES[SHAPE].conns;
+}
 
-void MLPBrain::init()
+size_t MLPBrain::chunkBytes()
 {
+    return SHAPES[SHAPE].chunkbytes;
+}
 
+size_t MLPBrain::brainBytes()
+{
+    return SHAPES[SHAPE].chunks*SHAPES[SHAPE].chunkbytes + SHAPES[SHAPE].statebytes;
 }
 
-void MLPBrain::tick(vector< float >& in, vector< float >& out)
+MLPBrain::MLPBrain() :
+        state(NULL)
 {
-    //do a single tick of the brain
-
-    //take first few boxes and set their out to in[].
-    for (int i=0;i<INPUTSIZE;i++) {
-        boxes[i].out= in[i];
-    }
-
-    //then do a dynamics tick and set all targets
-    for (int i=INPUTSIZE;i<BRAINSIZE;i++) {
-        MLPBox* abox= &boxes[i];
-        
-        float acc=0;
-        for (int j=0;j<CONNS;j++) {
-            int idx=abox->id[j];
-            int type = abox->type[j];
-            float val= boxes[idx].out;
-            
-            if(type==1){
-                val-= boxes[idx].oldout;
-                val*=10;
-            }
-            
-            acc= acc + val*abox->w[j];
-        }
-        acc*= abox->gw;
-        acc+= abox->bias;
-        
-        //put through sigmoid
-        acc= 1.0/(1.0+exp(-acc));
-        
-        abox->target= acc;
+    for (int c=0;c<MLPMAXCHUNKS;c++) chunk[c]= NULL;
+    SHAPES[SHAPE].randomize(*this);
+}
+
+MLPBrain::MLPBrain(const MLPBrain& other) :
+        state(NULL)
+{
+    for (int c=0;c<MLPMAXCHUNKS;c++) chunk[c]= NULL;
+    *this= other;
+}
+
+MLPBrain::MLPBrain(MLPBrain&& other) noexcept :
+        state(other.state)
+{
+    for (int c=0;c<MLPMAXCHUNKS;c++) {
+        chunk[c]= other.chunk[c];
+        other.chunk[c]= NULL;
     }
-    
-    //back up current out for each box
-    for (int i=0;i<BRAINSIZE;i++){
-        boxes[i].oldout = boxes[i].out;
+    other.state= NULL;
+}
+
+MLPBrain::~MLPBrain()
+{
+    release();
+}
+
+MLPBrain& MLPBrain::operator=(const MLPBrain& other)
+{
+    if( this != &other ) {
+        if (other.empty()) {
+            release();
+        } else {
+            //the genome is shared, only the state is copied
+            const ShapeOps& o= SHAPES[SHAPE];
+            for (int c=0;c<o.chunks;c++) share(c, other.chunk[c]);
+            if (state==NULL) state= (MLPState*) allocBlock(o.statebytes);
+            memcpy(state, other.state, o.statebytes);
+            bytescopied+= o.statebytes;
+        }
+        copies++;
     }
+    return *this;
+}
 
-    //make all boxes go a bit toward target
-    for (int i=INPUTSIZE;i<BRAINSIZE;i++) {
-        MLPBox* abox= &boxes[i];
-        abox->out =abox->out + (abox->target-abox->out)*abox->kp;
+MLPBrain& MLPBrain::operator=(MLPBrain&& other) noexcept
+{
+    if( this != &other ) {
+        for (int c=0;c<MLPMAXCHUNKS;c++) std::swap(chunk[c], other.chunk[c]);
+        std::swap(state, other.state);
     }
+    return *this;
+}
+
+void MLPBrain::share(int c, MLPChunk* k)
+{
+    if (chunk[c]==k) return;
+    k->refs++;
+    chunkrefs++;
+    unref(chunk[c]);
+    chunk[c]= k;
+}
 
-    //finally set out[] to the last few boxes output
-    for (int i=0;i<OUTPUTSIZE;i++) {
-        out[i]= boxes[BRAINSIZE-1-i].out;
+MLPChunk* MLPBrain::own(int c)
+{
+    MLPChunk* k= chunk[c];
+    if (k->refs==1) return k;
+
+    size_t bytes= SHAPES[SHAPE].chunkbytes;
+    MLPChunk* mine= allocChunk();
+    memcpy(mine, k, bytes);
+    mine->refs= 1;
+    livechunks++;
+    k->refs--; //the reference moves over to mine, so chunkrefs stays
+    chunk[c]= mine;
+    bytescopied+= bytes;
+    return mine;
+}
+
+void MLPBrain::load(const char* b)
+{
+    SHAPES[SHAPE].load(*this, b);
+}
+
+void MLPBrain::loadState(const char* b)
+{
+    SHAPES[SHAPE].loadState(*this, b);
+}
+
+void MLPBrain::store(char* b) const
+{
+    SHAPES[SHAPE].store(*this, b);
+}
+
+void MLPBrain::release()
+{
+    for (int c=0;c<MLPMAXCHUNKS;c++) {
+        unref(chunk[c]);
+        chunk[c]= NULL;
     }
+    bulkFree(state);
+    state= NULL;
 }
 
-void MLPBrain::mutate(float MR, float MR2)
+bool MLPBrain::empty() const
 {
-    for (int j=0;j<BRAINSIZE;j++) {
+    return state==NULL;
+}
 
-        if (randf(0,1)<MR) {
-            boxes[j].bias+= randn(0, MR2);
-//             a2.mutations.push_back("bias jiggled\n");
-        }
+int MLPBrain::stateSize() const
+{
+    return 2*SHAPES[SHAPE].boxes;
+}
 
-        if (randf(0,1)<MR) {
-            boxes[j].kp+= randn(0, MR2);
-            if (boxes[j].kp<0.01) boxes[j].kp=0.01;
-            if (boxes[j].kp>1) boxes[j].kp=1;
-//             a2.mutations.push_back("kp jiggled\n");
-        }
-        
-        if (randf(0,1)<MR) {
-            boxes[j].gw+= randn(0, MR2);
-            if (boxes[j].gw<0) boxes[j].gw=0;
-//             a2.mutations.push_back("kp jiggled\n");
-        }
+void MLPBrain::saveState(float* s) const
+{
+    SHAPES[SHAPE].saveState(*this, s);
+}
 
-        if (randf(0,1)<MR) {
-            int rc= randi(0, CONNS);
-            boxes[j].w[rc]+= randn(0, MR2);
-//          a2.mutations.push_back("weight jiggled\n");
-        }
-        
-        if (randf(0,1)<MR) {
-            int rc= randi(0, CONNS);
-            boxes[j].type[rc] = 1 - boxes[j].type[rc]; //flip type of synapse
-//          a2.mutations.push_back("weight jiggled\n");
-        }
+void MLPBrain::restoreState(const float* s)
+{
+    SHAPES[SHAPE].restoreState(*this, s);
+}
 
-        //more unlikely changes here
-        if (randf(0,1)<MR) {
-            int rc= randi(0, CONNS);
-            int ri= randi(0,BRAINSIZE);
-            boxes[j].id[rc]= ri;
-//             a2.mutations.push_back("connectivity changed\n");
-        }
+float MLPBrain::weight(int box, int conn) const
+{
+    return SHAPES[SHAPE].weight(*this, box, conn);
+}
+
+int MLPBrain::source(int box, int conn) const
+{
+    return SHAPES[SHAPE].source(*this, box, conn);
+}
+
+void MLPBrain::memoryUsage(size_t& payload, size_t& chunks) const
+{
+    if (empty()) return;
+    //bulkAlloc keeps a cache line of bookkeeping in front of each block
+    const ShapeOps& o= SHAPES[SHAPE];
+    payload+= o.statebytes;
+    chunks+= heapChunk(o.statebytes+CACHELINE);
+    for (int c=0;c<o.chunks;c++) {
+        payload+= o.chunkbytes/chunk[c]->refs;
+        chunks+= heapChunk(o.chunkbytes+CACHELINE)/chunk[c]->refs;
     }
 }
 
+void MLPBrain::tick(vector< float >& in, vector< float >& out)
+{
+    SHAPES[SHAPE].tickOwn(*this, &in[0], &out[0]);
+}
+
+void MLPBrain::tick(char* b, vector< float >& in, vector< float >& out)
+{
+    SHAPES[SHAPE].tick(b, &in[0], &out[0]);
+}
+
+void MLPBrain::mutate(float MR, float MR2, MutationLog* log)
+{
+    SHAPES[SHAPE].mutate(*this, MR, MR2, log);
+}
+
 MLPBrain MLPBrain::crossover(const MLPBrain& other)
 {
-    //this could be made faster by returning a pointer
-    //instead of returning by value
+    //child starts as a copy of this brain (state included), then every box
+    //that is inherited from other gets other's parameters. Boxes are picked
+    //by a coin flip each. A chunk with boxes from one parent only is shared
+    //with that parent, the others are copied and get other's runs of boxes
+    const ShapeOps& o= SHAPES[SHAPE];
     MLPBrain newbrain(*this);
-    
-    for (int i=0;i<newbrain.boxes.size(); i++) {
-        if(randf(0,1)<0.5){
-            newbrain.boxes[i].bias= this->boxes[i].bias;
-            newbrain.boxes[i].gw= this->boxes[i].gw;
-            newbrain.boxes[i].kp= this->boxes[i].kp;
-            for (int j=0;j<newbrain.boxes[i].id.size();j++) {
-                newbrain.boxes[i].id[j] = this->boxes[i].id[j];
-                newbrain.boxes[i].w[j] = this->boxes[i].w[j];
-                newbrain.boxes[i].type[j] = this->boxes[i].type[j];
-            }
-        
-        } else {
-            newbrain.boxes[i].bias= other.boxes[i].bias;
-            newbrain.boxes[i].gw= other.boxes[i].gw;
-            newbrain.boxes[i].kp= other.boxes[i].kp;
-            for (int j=0;j<newbrain.boxes[i].id.size();j++) {
-                newbrain.boxes[i].id[j] = other.boxes[i].id[j];
-                newbrain.boxes[i].w[j] = other.boxes[i].w[j];
-                newbrain.boxes[i].type[j] = other.boxes[i].type[j];
-            }
+    RandBits coin;
+    for (int c=0;c<o.chunks;c++) {
+        int n= min(o.chunkboxes, o.boxes-c*o.chunkboxes); //the last chunk may not be full
+        bool fromother[MAXCHUNKBOXES];
+        int count= 0;
+        for (int i=0;i<n;i++) {
+            fromother[i]= !coin.next();
+            count+= fromother[i];
+        }
+        if (count==0) continue;
+        if (count==n) {
+            newbrain.share(c, other.chunk[c]);
+            continue;
+        }
+
+        MLPChunk* k= newbrain.own(c);
+        for (int a=0, b=1; a<n; a=b++) {
+            while (b<n && fromother[b]==fromother[a]) b++;
+            if (fromother[a]) o.copyBoxes(k, other.chunk[c], a, b);
         }
     }
     return newbrain;
 }
-
@@ -3,46 +3,93 @@
 
 #include "settings.h"
 #include "helpers.h"
+#include "MutationLog.h"
+#include "MLPKernels.h"
 
 #include <vector>
 #include <stdio.h>
 
-class MLPBox {
-public:
-
-    MLPBox();
+const int MLPMAXCHUNKS= 16; //genome chunks of a brain, in the biggest shape
 
-    std::vector<float> w; //weight of each connecting box
-    std::vector<int> id; //id in boxes[] of the connecting box
-    std::vector<int> type; //0: regular synapse. 1: change-sensitive synapse
-    float kp; //damper
-    float gw; //global w
-    float bias;
+//genome of a run of consecutive boxes, laid out as in MLPBoxesT for the
+//shape in use (see MLPBrain.cpp). Every brain that has these boxes
+//unchanged points to the same chunk, which is not written while more than
+//one does
+struct MLPChunk {
+    int refs;
+};
 
-    //state variables
-    float target; //target value this node is going toward
-    float out; //current output
-    float oldout; //output a tick ago
+//state variables of all boxes, also laid out per shape. A brain owns these alone
+struct MLPState {
 };
 
+template <int N, int C> struct MLPShape;
+
 /**
- * Damped Weighted Recurrent AND/OR Network
+ * Recurrent network of sigmoid units, each with a few weighted inputs, in
+ * the shape picked at startup (see BrainShapes.h; all brains have it).
+ * The genome is kept in reference counted chunks of 16 or 32 boxes: a copy
+ * shares all of them with the original, and mutate and crossover copy only
+ * the chunks they change. The state belongs to each brain. Brains are only
+ * copied on one thread, so the counts are not atomic.
  */
 class MLPBrain
 {
 public:
 
-    std::vector<MLPBox> boxes;
-
     MLPBrain();
     MLPBrain(const MLPBrain &other);
+    MLPBrain(MLPBrain &&other) noexcept;
+    ~MLPBrain();
     virtual MLPBrain& operator=(const MLPBrain& other);
+    virtual MLPBrain& operator=(MLPBrain&& other) noexcept;
 
     void tick(std::vector<float>& in, std::vector<float>& out);
-    void mutate(float MR, float MR2);
+    void mutate(float MR, float MR2, MutationLog* log= NULL); //log, if given, records every mutation
     MLPBrain crossover( const MLPBrain &other );
+
+    //b points to the boxes of a brain stored flat elsewhere, an MLPBoxesT of the shape
+    void load(const char* b); //become a copy of them
+    void loadState(const char* b); //take only their state, whose genome must be this brain's
+    void store(char* b) const; //write genome and state into them
+    void release(); //give back genome and state, leaving an empty brain
+    bool empty() const; //after it was moved from or released
+
+    //the state, stateSize() floats written to or read from s (see mlpSaveState)
+    int stateSize() const;
+    void saveState(float* s) const;
+    void restoreState(const float* s);
+
+    float weight(int box, int conn) const;
+    int source(int box, int conn) const; //box that synapse conn of box reads from
+
+    //adds the heap bytes this brain owns to payload, and what malloc really takes
+    //for them to chunks. Shared genome chunks count for this brain's share
+    void memoryUsage(size_t& payload, size_t& chunks) const;
+
+    //tick boxes that live somewhere else, such as a BrainArena slot
+    static void tick(char* b, std::vector<float>& in, std::vector<float>& out);
+
+    //the shape of all MLP brains, an index into BrainShapes.h. It can only
+    //change while there are none, else setShape is false and it stays
+    static bool setShape(int i);
+    static int shape();
+    static int boxes();
+    static int conns();
+    static size_t chunkBytes();
+    static size_t brainBytes(); //genome and state of one brain that shares nothing
+
+    static long copies; //number of copies made so far. Moves don't count
+    static long long bytescopied; //genome and state bytes copied by copies, crossover and copy-on-write
+    static void chunkStats(long& chunks, long& refs); //genome chunks alive, and how many brains point to them
 private:
-    void init();
+    MLPChunk* chunk[MLPMAXCHUNKS]; //as many as the shape has, all NULL in an empty brain
+    MLPState* state;
+
+    template <int N, int C> friend struct MLPShape;
+
+    MLPChunk* own(int c); //chunk c, copied first if another brain has it too
+    void share(int c, MLPChunk* k); //point chunk c at k
 };
 
 #endif
@@ -0,0 +1,475 @@
+#ifndef MLPKERNELS_H
+#define MLPKERNELS_H
+
+#include "helpers.h"
+#include "Sigmoid.h"
+
+#include <vector>
+#include <type_traits>
+#include <limits>
+#include <algorithm>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * The MLP brain with its dimensions as template parameters: N boxes, the
+ * first IN of which are inputs and the last OUT of which are read as
+ * outputs, each with C synapses. The simulation runs one of the shapes of
+ * BrainShapes.h, picked at startup, so larger brains can be tried without
+ * editing settings.h. Loops over C and the block lanes have constant trip
+ * counts and get unrolled.
+ */
+
+const int MLPLANES= 8; //brains per interleaved block
+
+//all boxes of one brain, stored flat. Box i owns synapses i*C .. i*C+C-1 of w[] and id[]
+template <int N, int C>
+struct MLPBoxesT {
+    static_assert(C<=8, "synapse types are kept as a bitmask in a byte, C must be at most 8");
+    typedef typename std::conditional<(N<=256), unsigned char, unsigned short>::type BoxId;
+
+    float w[N*C]; //weight of each synapse
+    float kp[N]; //damper
+    float gw[N]; //global w
+    float bias[N];
+
+    //state variables
+    float target[N]; //target value this node is going toward
+    float out[2][N]; //out[cur] is the current output, out[!cur] the output a tick ago
+
+    BoxId id[N*C]; //id of the box each synapse reads from
+    unsigned char type[N]; //bit j set: synapse j is change-sensitive, else regular
+    unsigned char cur; //flips every tick, as the new output is written over the old one
+
+    float* now() { return out[cur]; }
+    const float* now() const { return out[cur]; }
+};
+
+//which boxes of MLPLANES brains an evaluation plan computes. Each lane only
+//has rows for the boxes that can reach the outputs, packed to the front: row
+//r computes box box[r][l] of lane l. Lanes with fewer boxes than rows are
+//padded with rows that compute nothing, box -1
+template <int N, int IN>
+struct MLPPlanT {
+    int box[N-IN][MLPLANES];
+    int rows;
+
+    //pruning statistics of each lane
+    int live[MLPLANES]; //boxes computed
+    int synapses[MLPLANES]; //synapses of those that can change their box
+};
+
+//evaluation plan with the genomes of its brains interleaved, so synapse k of
+//all of them sits side by side
+template <int N, int C, int IN>
+struct MLPBlockT : MLPPlanT<N,IN> {
+    float w[(N-IN)*C][MLPLANES];
+    int src[(N-IN)*C][MLPLANES]; //out[0][id] of the lane's brain, as a float index from the block's first brain
+    int type[(N-IN)*C][MLPLANES]; //1 if change-sensitive
+    float gw[N-IN][MLPLANES];
+    float bias[N-IN][MLPLANES];
+};
+
+//the same with the weights quantized to Q (int8_t or int16_t), with a scale
+//per box and lane that is folded into gw. Each synapse takes a Q and a box
+//id instead of 12 bytes. Rounding to nearest, a weight is off by at most
+//scale/2, scale being the largest weight of the box over the largest Q. A
+//regular synapse reads a value in [0,1], a change-sensitive one in [-10,10],
+//and the sigmoid is at most 1/4 steep, so in one tick a target moves by at
+//most gw*scale/2 * (sum of 1 or 10 over the synapses) / 4, and the output
+//by kp times that
+template <int N, int C, int IN, typename Q>
+struct MLPQBlockT : MLPPlanT<N,IN> {
+    typedef typename MLPBoxesT<N,C>::BoxId BoxId;
+
+    Q w[(N-IN)*C][MLPLANES];
+    BoxId id[(N-IN)*C][MLPLANES];
+    unsigned char type[N-IN][MLPLANES]; //bit j set: synapse j is change-sensitive
+    float gw[N-IN][MLPLANES]; //times the scale of the weights
+    float bias[N-IN][MLPLANES];
+};
+
+//random genome, zero state
+template <int N, int C, int IN>
+void mlpRandomize(MLPBoxesT<N,C>& b)
+{
+    for (int i=0;i<N;i++) {
+        b.type[i]= 0;
+        for (int j=0;j<C;j++) {
+            int s= i*C+j;
+            b.w[s]= randf(-3,3);
+            if(randf(0,1)<0.5) b.w[s]=0; //make brains sparse
+
+            b.id[s]= randi(0,N);
+            if (randf(0,1)<0.2) b.id[s]= randi(0,IN); //20% of the brain AT LEAST should connect to input.
+
+            if(randf(0,1)<0.05) b.type[i] |= 1<<j; //make 5% be change sensitive synapses
+        }
+
+        b.kp[i]= randf(0.9,1.1);
+        b.gw[i]= randf(0,5);
+        b.bias[i]= randf(-2,2);
+
+        b.out[0][i]=0;
+        b.out[1][i]=0;
+        b.target[i]=0;
+    }
+    b.cur= 0;
+}
+
+//do a single tick of one brain
+template <int N, int C, int IN, int OUT>
+void mlpTick(MLPBoxesT<N,C>& b, const float* in, float* out)
+{
+    float* o= b.out[b.cur];
+    float* old= b.out[!b.cur];
+
+    //take first few boxes and set their out to in[].
+    for (int i=0;i<IN;i++) {
+        o[i]= in[i];
+    }
+
+    //then do a dynamics tick and set all targets
+    for (int i=IN;i<N;i++) {
+        const float* w= &b.w[i*C];
+        const typename MLPBoxesT<N,C>::BoxId* id= &b.id[i*C];
+        int type= b.type[i];
+
+        float acc=0;
+        for (int j=0;j<C;j++) {
+            int idx= id[j];
+            float val= o[idx];
+
+            if((type>>j)&1){
+                val-= old[idx];
+                val*=10;
+            }
+
+            acc= acc + val*w[j];
+        }
+        acc*= b.gw[i];
+        acc+= b.bias[i];
+
+        b.target[i]= acc;
+    }
+
+    //put all of them through sigmoid
+    sigmoidArray(sigmoidKind(), &b.target[IN], N-IN);
+
+    //make all boxes go a bit toward target, into the other buffer, which
+    //then becomes the current one and leaves this one as the output a tick ago
+    memcpy(old, o, IN*sizeof(float));
+    for (int i=IN;i<N;i++) {
+        old[i]= o[i] + (b.target[i]-o[i])*b.kp[i];
+    }
+    b.cur= !b.cur;
+
+    //finally set out[] to the last few boxes output
+    for (int i=0;i<OUT;i++) {
+        out[i]= old[N-1-i];
+    }
+}
+
+//the state of one brain that carries over from tick to tick: the current
+//outputs, then those of a tick ago, 2*N floats. target[] is left out, as a
+//tick writes it before it reads it. Restoring keeps cur as it is
+template <int N>
+void mlpSaveState(const float (*out)[N], int cur, float* s)
+{
+    memcpy(s, out[cur], N*sizeof(float));
+    memcpy(s+N, out[!cur], N*sizeof(float));
+}
+
+template <int N>
+void mlpRestoreState(const float* s, float (*out)[N], int cur)
+{
+    memcpy(out[cur], s, N*sizeof(float));
+    memcpy(out[!cur], s+N, N*sizeof(float));
+}
+
+//a synapse whose weight is 0, or that feeds a box with a global weight of 0,
+//adds exactly nothing as long as the outputs are finite, which they are
+template <int N, int C>
+bool mlpSynapseLive(const MLPBoxesT<N,C>& b, int i, int j)
+{
+    return b.w[i*C+j]!=0 && b.gw[i]!=0;
+}
+
+//marks in live[] the boxes of b that can influence the OUT outputs through
+//live synapses. Inputs are set, not computed, so they are never marked
+template <int N, int C, int IN, int OUT>
+void mlpLiveBoxes(const MLPBoxesT<N,C>& b, bool* live)
+{
+    int stack[N];
+    int top= 0;
+    for (int i=0;i<N;i++) live[i]= false;
+    for (int i=0;i<OUT;i++) {
+        if (N-1-i<IN || live[N-1-i]) continue;
+        live[N-1-i]= true;
+        stack[top++]= N-1-i;
+    }
+    while (top>0) {
+        int i= stack[--top];
+        for (int j=0;j<C;j++) {
+            int src= b.id[i*C+j];
+            if (src<IN || live[src] || !mlpSynapseLive(b, i, j)) continue;
+            live[src]= true;
+            stack[top++]= src;
+        }
+    }
+}
+
+//pick the boxes of the MLPLANES brains that start at first, stride bytes
+//apart, that p computes. Lanes with bit l of full set compute every box, the
+//others only the live ones. Boxes left out get the same output in both
+//buffers, as they would have after a tick of not moving. Lanes with bit l of
+//skip set are ticked elsewhere, so they get no rows and are left as they are
+template <int N, int C, int IN, int OUT>
+void mlpBuildPlan(MLPPlanT<N,IN>& p, char* first, size_t stride, unsigned int full, unsigned int skip= 0)
+{
+    typedef MLPBoxesT<N,C> Boxes;
+    p.rows= 0;
+    for (int l=0;l<MLPLANES;l++) {
+        Boxes* m= (Boxes*) (first + l*stride);
+        if ((skip>>l)&1) {
+            p.live[l]= 0;
+            p.synapses[l]= 0;
+            continue;
+        }
+        bool live[N];
+        if ((full>>l)&1) {
+            for (int i=0;i<N;i++) live[i]= i>=IN;
+        } else {
+            mlpLiveBoxes<N,C,IN,OUT>(*m, live);
+        }
+
+        int n= 0;
+        p.synapses[l]= 0;
+        for (int i=IN;i<N;i++) {
+            if (!live[i]) {
+                m->out[!m->cur][i]= m->out[m->cur][i];
+                continue;
+            }
+            for (int j=0;j<C;j++) {
+                if (mlpSynapseLive(*m, i, j)) p.synapses[l]++;
+            }
+            p.box[n][l]= i;
+            n++;
+        }
+        p.live[l]= n;
+        if (n>p.rows) p.rows= n;
+    }
+    for (int l=0;l<MLPLANES;l++) {
+        for (int n=p.live[l];n<p.rows;n++) p.box[n][l]= -1;
+    }
+}
+
+//build the float plan of a block, see mlpBuildPlan
+template <int N, int C, int IN, int OUT>
+void mlpBuildBlock(MLPBlockT<N,C,IN>& k, char* first, size_t stride, unsigned int full, unsigned int skip= 0)
+{
+    typedef MLPBoxesT<N,C> Boxes;
+    const int outoff= offsetof(Boxes, out)/sizeof(float);
+    mlpBuildPlan<N,C,IN,OUT>(k, first, stride, full, skip);
+    for (int l=0;l<MLPLANES;l++) {
+        const Boxes* m= (const Boxes*) (first + l*stride);
+        const int base= l*stride/sizeof(float) + outoff;
+        for (int n=0;n<k.rows;n++) {
+            int i= k.box[n][l];
+            for (int j=0;j<C;j++) {
+                //padding rows read the lane's first box with no weight
+                k.w[n*C+j][l]= i<0 ? 0 : m->w[i*C+j];
+                k.src[n*C+j][l]= base + (i<0 ? 0 : m->id[i*C+j]);
+                k.type[n*C+j][l]= i<0 ? 0 : (m->type[i]>>j)&1;
+            }
+            k.gw[n][l]= i<0 ? 0 : m->gw[i];
+            k.bias[n][l]= i<0 ? 0 : m->bias[i];
+        }
+    }
+}
+
+//build the quantized plan of a block, see mlpBuildPlan
+template <int N, int C, int IN, int OUT, typename Q>
+void mlpBuildBlock(MLPQBlockT<N,C,IN,Q>& k, char* first, size_t stride, unsigned int full, unsigned int skip= 0)
+{
+    typedef MLPBoxesT<N,C> Boxes;
+    const float qmax= std::numeric_limits<Q>::max();
+    mlpBuildPlan<N,C,IN,OUT>(k, first, stride, full, skip);
+    for (int l=0;l<MLPLANES;l++) {
+        const Boxes* m= (const Boxes*) (first + l*stride);
+        for (int n=0;n<k.rows;n++) {
+            int i= k.box[n][l];
+            float big= 0;
+            for (int j=0;i>=0 && j<C;j++) big= std::max(big, fabsf(m->w[i*C+j]));
+            float scale= big/qmax;
+            for (int j=0;j<C;j++) {
+                k.w[n*C+j][l]= big==0 ? 0 : (Q) lrintf(m->w[i*C+j]/scale);
+                k.id[n*C+j][l]= i<0 ? 0 : m->id[i*C+j];
+            }
+            k.type[n][l]= i<0 ? 0 : m->type[i];
+            k.gw[n][l]= i<0 ? 0 : m->gw[i]*scale;
+            k.bias[n][l]= i<0 ? 0 : m->bias[i];
+        }
+    }
+}
+
+//the lanes of a block are ticked in step, so their cur agree, but a brain
+//that was just loaded may be a tick out of phase with the others. Its two
+//buffers are swapped then, which keeps its state the same. Returns the cur
+//of the lanes with in[l] not NULL
+template <int N, int C>
+int mlpAlignBuffers(char* first, size_t stride, std::vector<float>* const* in)
+{
+    typedef MLPBoxesT<N,C> Boxes;
+    int cur= -1;
+    for (int l=0;l<MLPLANES;l++) {
+        if (in[l]==NULL) continue;
+        Boxes& m= *(Boxes*) (first + l*stride);
+        if (cur==-1) cur= m.cur;
+        if (m.cur==cur) continue;
+        for (int i=0;i<N;i++) std::swap(m.out[0][i], m.out[1][i]);
+        m.cur= cur;
+    }
+    return cur==-1 ? 0 : cur;
+}
+
+//tick the brains of a block whose in[l] is not NULL. Same arithmetic, in
+//the same order, as mlpTick for the boxes in the plan. The others keep their
+//state. Lanes that are not ticked are computed too, but left out of
+//everything after the targets
+template <int N, int C, int IN, int OUT>
+void mlpTickBlock(const MLPBlockT<N,C,IN>& k, char* first, size_t stride,
+                  std::vector<float>* const* in, std::vector<float>* const* out)
+{
+    typedef MLPBoxesT<N,C> Boxes;
+    const float* base= (const float*) first;
+    const int cur= mlpAlignBuffers<N,C>(first, stride, in);
+    const float* now= base + cur*N;
+    const float* then= base + (!cur)*N;
+
+    for (int l=0;l<MLPLANES;l++) {
+        if (in[l]==NULL) continue;
+        Boxes* m= (Boxes*) (first + l*stride);
+        for (int i=0;i<IN;i++) m->now()[i]= (*in[l])[i];
+    }
+
+    const int rows= k.rows;
+    float z[N-IN][MLPLANES];
+    for (int n=0;n<rows;n++) {
+        float* acc= z[n];
+        for (int l=0;l<MLPLANES;l++) acc[l]= 0;
+
+        for (int j=0;j<C;j++) {
+            const int c= n*C+j;
+            for (int l=0;l<MLPLANES;l++) {
+                int idx= k.src[c][l];
+                float val= now[idx];
+                if (k.type[c][l]) {
+                    val-= then[idx];
+                    val*= 10;
+                }
+                acc[l]= acc[l] + val*k.w[c][l];
+            }
+        }
+
+        for (int l=0;l<MLPLANES;l++) {
+            acc[l]*= k.gw[n][l];
+            acc[l]+= k.bias[n][l];
+        }
+    }
+
+    sigmoidArray(sigmoidKind(), &z[0][0], rows*MLPLANES);
+
+    for (int l=0;l<MLPLANES;l++) {
+        Boxes* m= (Boxes*) (first + l*stride);
+        for (int n=0;n<k.live[l];n++) m->target[k.box[n][l]]= z[n][l];
+    }
+
+    for (int l=0;l<MLPLANES;l++) {
+        if (in[l]==NULL) continue;
+        Boxes& m= *(Boxes*) (first + l*stride);
+        const float* o= m.out[m.cur];
+        float* p= m.out[!m.cur];
+        memcpy(p, o, IN*sizeof(float)); //boxes left out already have the same output in both
+        for (int n=0;n<k.live[l];n++) {
+            int i= k.box[n][l];
+            p[i]= o[i] + (m.target[i]-o[i])*m.kp[i];
+        }
+        m.cur= !m.cur;
+        for (int i=0;i<OUT;i++) {
+            (*out[l])[i]= p[N-1-i];
+        }
+    }
+}
+
+//tick a quantized block, the same way as mlpTickBlock does a float one
+template <int N, int C, int IN, int OUT, typename Q>
+void mlpTickBlock(const MLPQBlockT<N,C,IN,Q>& k, char* first, size_t stride,
+                  std::vector<float>* const* in, std::vector<float>* const* out)
+{
+    typedef MLPBoxesT<N,C> Boxes;
+    const float* base= (const float*) first;
+    const int cur= mlpAlignBuffers<N,C>(first, stride, in);
+    const float* now= base + cur*N;
+    const float* then= base + (!cur)*N;
+    int lanebase[MLPLANES];
+    for (int l=0;l<MLPLANES;l++) lanebase[l]= (l*stride+offsetof(Boxes, out))/sizeof(float);
+
+    for (int l=0;l<MLPLANES;l++) {
+        if (in[l]==NULL) continue;
+        Boxes* m= (Boxes*) (first + l*stride);
+        for (int i=0;i<IN;i++) m->now()[i]= (*in[l])[i];
+    }
+
+    const int rows= k.rows;
+    float z[N-IN][MLPLANES];
+    for (int n=0;n<rows;n++) {
+        float* acc= z[n];
+        for (int l=0;l<MLPLANES;l++) acc[l]= 0;
+
+        for (int j=0;j<C;j++) {
+            const int c= n*C+j;
+            for (int l=0;l<MLPLANES;l++) {
+                int idx= lanebase[l] + k.id[c][l];
+                float val= now[idx];
+                if ((k.type[n][l]>>j)&1) {
+                    val-= then[idx];
+                    val*= 10;
+                }
+                acc[l]= acc[l] + val*k.w[c][l];
+            }
+        }
+
+        for (int l=0;l<MLPLANES;l++) {
+            acc[l]*= k.gw[n][l];
+            acc[l]+= k.bias[n][l];
+        }
+    }
+
+    sigmoidArray(sigmoidKind(), &z[0][0], rows*MLPLANES);
+
+    for (int l=0;l<MLPLANES;l++) {
+        Boxes* m= (Boxes*) (first + l*stride);
+        for (int n=0;n<k.live[l];n++) m->target[k.box[n][l]]= z[n][l];
+    }
+
+    for (int l=0;l<MLPLANES;l++) {
+        if (in[l]==NULL) continue;
+        Boxes& m= *(Boxes*) (first + l*stride);
+        const float* o= m.out[m.cur];
+        float* p= m.out[!m.cur];
+        memcpy(p, o, IN*sizeof(float)); //boxes left out already have the same output in both
+        for (int n=0;n<k.live[l];n++) {
+            int i= k.box[n][l];
+            p[i]= o[i] + (m.target[i]-o[i])*m.kp[i];
+        }
+        m.cur= !m.cur;
+        for (int i=0;i<OUT;i++) {
+            (*out[l])[i]= p[N-1-i];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,439 @@
+#include "MLPNative.h"
+#include "BrainShapes.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#if defined(__unix__) || defined(__APPLE__)
+#define MLPNATIVE_POSIX
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+using namespace std;
+
+long MLPNative::builds= 0;
+long MLPNative::failures= 0;
+double MLPNative::buildseconds= 0;
+long MLPNative::hits= 0;
+long MLPNative::ticks= 0;
+
+typedef void (*Fn)(const float* now, const float* then, float* z);
+
+enum { QUEUED, COMPILING, READY, FAILED };
+
+struct MLPNative::Code {
+    vector<char> key; //genome as bytes, what the code was made from
+    vector<int> box; //box of each target the code computes, in order
+    string src; //the C++ until it is written out
+    int refs;
+    int status;
+    Fn fn;
+    void* handle;
+    int id; //of its files
+#ifdef MLPNATIVE_POSIX
+    pid_t pid;
+#endif
+    chrono::steady_clock::time_point started;
+};
+
+const size_t MAXIDLE= 256; //codes kept for genomes no brain has right now
+const int MAXFAILS= 3; //compiles in a row that fail before the compiler is given up on
+
+static bool ENABLED= false;
+static bool broken= false; //the compiler failed MAXFAILS times in a row
+static int fails= 0;
+static multimap<uint64_t, MLPNative::Code*> cache; //by hash of the key
+static deque<MLPNative::Code*> queue; //waiting for the compiler
+static MLPNative::Code* compiling= NULL;
+static vector<MLPNative::Code*> idle; //refs 0, oldest first
+static string dir; //where the sources and libraries go
+static int nextid= 0;
+
+bool MLPNative::available()
+{
+#ifdef MLPNATIVE_POSIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MLPNative::setEnabled(bool on)
+{
+    ENABLED= on && available();
+}
+
+bool MLPNative::enabled()
+{
+    return ENABLED && !broken;
+}
+
+bool MLPNative::ready(const Code* c)
+{
+    return c->status==READY;
+}
+
+static uint64_t hashBytes(const vector<char>& v)
+{
+    uint64_t h= 14695981039346656037ull; //FNV-1a
+    for (size_t i=0;i<v.size();i++) {
+        h^= (unsigned char) v[i];
+        h*= 1099511628211ull;
+    }
+    return h;
+}
+
+template <class T>
+static void append(vector<char>& v, const T* p, size_t n)
+{
+    const char* c= (const char*) p;
+    v.insert(v.end(), c, c+n*sizeof(T));
+}
+
+//a float that reads back as exactly the same float
+static void put(string& s, float f)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "(%.9ef)", f);
+    s+= buf;
+}
+
+//the targets of boxes box[] before the sigmoid, as mlpTickBlock computes
+//them. Synapses with weight 0 add exactly nothing, so they are left out
+template <int N, int C>
+static string source(const MLPBoxesT<N,C>& b, const vector<int>& box)
+{
+    string s= "//generated by ScriptBots from one MLP genome, see MLPNative.h\n"
+              "extern \"C\" void mlp_native_tick(const float* now, const float* then, float* z)\n"
+              "{\n"
+              "    float acc;\n";
+    char buf[96];
+    for (size_t r=0;r<box.size();r++) {
+        int i= box[r];
+        s+= "    acc= 0;\n";
+        for (int j=0;j<C;j++) {
+            float w= b.w[i*C+j];
+            if (w==0) continue;
+            int idx= b.id[i*C+j];
+            if ((b.type[i]>>j)&1) snprintf(buf, sizeof(buf), "    acc= acc + ((now[%i]-then[%i])*10.0f)*", idx, idx);
+            else snprintf(buf, sizeof(buf), "    acc= acc + now[%i]*", idx);
+            s+= buf;
+            put(s, w);
+            s+= ";\n";
+        }
+        s+= "    acc*= ";
+        put(s, b.gw[i]);
+        s+= ";\n    acc+= ";
+        put(s, b.bias[i]);
+        snprintf(buf, sizeof(buf), ";\n    z[%i]= acc;\n", (int) r);
+        s+= buf;
+    }
+    s+= "}\n";
+    return s;
+}
+
+static bool finite(const float* f, int n)
+{
+    for (int i=0;i<n;i++) if (!isfinite(f[i])) return false;
+    return true;
+}
+
+#ifdef MLPNATIVE_POSIX
+
+static string path(const MLPNative::Code* c, const char* ext)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "/mlp%i.%s", c->id, ext);
+    return dir+buf;
+}
+
+static void release(MLPNative::Code* c)
+{
+    if (c==compiling) {
+        kill(c->pid, SIGKILL);
+        waitpid(c->pid, NULL, 0);
+        unlink(path(c, "cpp").c_str());
+        unlink(path(c, "so").c_str());
+        compiling= NULL;
+    }
+    if (c->handle!=NULL) dlclose(c->handle);
+}
+
+static void removeDir()
+{
+    if (compiling!=NULL) release(compiling);
+    rmdir(dir.c_str());
+}
+
+static bool makeDir()
+{
+    if (!dir.empty()) return true;
+    const char* tmp= getenv("TMPDIR");
+    string t= string(tmp!=NULL && tmp[0]!=0 ? tmp : "/tmp") + "/scriptbots-XXXXXX";
+    vector<char> buf(t.begin(), t.end());
+    buf.push_back(0);
+    if (mkdtemp(&buf[0])==NULL) return false;
+    dir= &buf[0];
+    atexit(removeDir);
+    return true;
+}
+
+//run the compiler on c in the background. False if it could not be started
+static bool start(MLPNative::Code* c)
+{
+    if (!makeDir()) return false;
+    c->id= nextid++;
+    string src= path(c, "cpp"), lib= path(c, "so");
+    FILE* fp= fopen(src.c_str(), "w");
+    if (fp==NULL) return false;
+    bool ok= fwrite(c->src.data(), 1, c->src.size(), fp)==c->src.size();
+    ok= fclose(fp)==0 && ok;
+    string().swap(c->src);
+    if (!ok) {
+        unlink(src.c_str());
+        return false;
+    }
+
+    //no FMA and no reassociation, so the sums come out as in mlpTickBlock
+    const char* cxx= getenv("CXX");
+    if (cxx==NULL || cxx[0]==0) cxx= "c++";
+    const char* argv[]= {cxx, "-O1", "-ffp-contract=off", "-fno-fast-math", "-shared", "-fPIC",
+                         "-o", lib.c_str(), src.c_str(), NULL};
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&fa, 2, "/dev/null", O_WRONLY, 0);
+    int err= posix_spawnp(&c->pid, cxx, &fa, NULL, (char* const*) argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    if (err!=0) {
+        unlink(src.c_str());
+        return false;
+    }
+    c->status= COMPILING;
+    c->started= chrono::steady_clock::now();
+    compiling= c;
+    return true;
+}
+
+//the compile of c is over, with wait status st
+static void done(MLPNative::Code* c, int st)
+{
+    compiling= NULL;
+    string lib= path(c, "so");
+    unlink(path(c, "cpp").c_str());
+    if (WIFEXITED(st) && WEXITSTATUS(st)==0) {
+        c->handle= dlopen(lib.c_str(), RTLD_NOW|RTLD_LOCAL);
+        if (c->handle!=NULL) c->fn= (Fn) dlsym(c->handle, "mlp_native_tick");
+    }
+    unlink(lib.c_str()); //stays mapped while it is open
+    if (c->fn==NULL) {
+        if (c->handle!=NULL) dlclose(c->handle);
+        c->handle= NULL;
+        c->status= FAILED;
+        MLPNative::failures++;
+        fails++;
+        return;
+    }
+    c->status= READY;
+    fails= 0;
+    MLPNative::builds++;
+    MLPNative::buildseconds+= chrono::duration<double>(chrono::steady_clock::now()-c->started).count();
+}
+
+#else
+
+static bool start(MLPNative::Code*)
+{
+    return false;
+}
+
+static void release(MLPNative::Code*)
+{
+}
+
+#endif
+
+static void destroy(MLPNative::Code* c)
+{
+    release(c);
+    uint64_t h= hashBytes(c->key);
+    for (multimap<uint64_t, MLPNative::Code*>::iterator it= cache.lower_bound(h); it!=cache.end() && it->first==h; ++it) {
+        if (it->second==c) {
+            cache.erase(it);
+            break;
+        }
+    }
+    queue.erase(std::remove(queue.begin(), queue.end(), c), queue.end());
+    delete c;
+}
+
+//the parts that depend on the shape of the brains, N boxes with C synapses each
+template <int N, int C>
+struct NativeShape {
+    typedef MLPBoxesT<N,C> Boxes;
+
+    //the genome of the brain at p as bytes, plus full. False if some of it is not finite
+    static bool key(const char* p, bool full, vector<char>& key)
+    {
+        const Boxes& b= *(const Boxes*) p;
+        if (!finite(b.w, N*C) || !finite(b.gw, N) || !finite(b.bias, N)) return false;
+        append(key, b.w, N*C);
+        append(key, b.id, N*C);
+        append(key, b.type, N);
+        append(key, b.gw, N);
+        append(key, b.bias, N);
+        key.push_back(full);
+        return true;
+    }
+
+    //the boxes the code computes, and its source
+    static void plan(const char* p, bool full, vector<int>& box, string& src)
+    {
+        const Boxes& b= *(const Boxes*) p;
+        bool live[N];
+        if (full) {
+            for (int i=0;i<N;i++) live[i]= i>=INPUTSIZE;
+        } else {
+            mlpLiveBoxes<N,C,INPUTSIZE,OUTPUTSIZE>(b, live);
+        }
+        for (int i=INPUTSIZE;i<N;i++) if (live[i]) box.push_back(i);
+        src= source(b, box);
+    }
+
+    static void tick(const MLPNative::Code* c, char* p, const float* in, float* out)
+    {
+        Boxes& m= *(Boxes*) p;
+        float* o= m.out[m.cur];
+        float* q= m.out[!m.cur];
+        for (int i=0;i<INPUTSIZE;i++) o[i]= in[i];
+
+        float z[N];
+        c->fn(o, q, z);
+        const int rows= c->box.size();
+        sigmoidArray(sigmoidKind(), z, rows);
+
+        //then as mlpTickBlock does for one lane
+        memcpy(q, o, INPUTSIZE*sizeof(float));
+        for (int r=0;r<rows;r++) {
+            int i= c->box[r];
+            m.target[i]= z[r];
+            q[i]= o[i] + (m.target[i]-o[i])*m.kp[i];
+        }
+        m.cur= !m.cur;
+        for (int i=0;i<OUTPUTSIZE;i++) {
+            out[i]= q[N-1-i];
+        }
+    }
+};
+
+//NativeShape of every shape of BrainShapes.h, in that order
+struct NativeOps {
+    bool (*key)(const char* p, bool full, vector<char>& key);
+    void (*plan)(const char* p, bool full, vector<int>& box, string& src);
+    void (*tick)(const MLPNative::Code* c, char* p, const float* in, float* out);
+};
+
+#define NATIVE_OPS(n,c) { NativeShape<n,c>::key, NativeShape<n,c>::plan, NativeShape<n,c>::tick },
+static const NativeOps SHAPES[]= { MLP_SHAPES(NATIVE_OPS) };
+
+MLPNative::Code* MLPNative::request(const char* b, bool full)
+{
+    if (!enabled()) return NULL;
+    const NativeOps& ops= SHAPES[MLPBrain::shape()];
+    vector<char> key;
+    if (!ops.key(b, full, key)) return NULL;
+    uint64_t h= hashBytes(key);
+    for (multimap<uint64_t, Code*>::iterator it= cache.lower_bound(h); it!=cache.end() && it->first==h; ++it) {
+        Code* c= it->second;
+        if (c->key!=key) continue;
+        if (c->refs++==0) idle.erase(std::find(idle.begin(), idle.end(), c));
+        hits++;
+        return c;
+    }
+
+    Code* c= new Code();
+    c->key.swap(key);
+    ops.plan(b, full, c->box, c->src);
+    c->refs= 1;
+    c->status= QUEUED;
+    c->fn= NULL;
+    c->handle= NULL;
+    c->id= -1;
+    cache.insert(make_pair(h, c));
+    queue.push_back(c);
+    return c;
+}
+
+void MLPNative::drop(Code* c)
+{
+    if (c==NULL || --c->refs>0) return;
+    if (c->status==QUEUED || c->status==COMPILING) {
+        //nobody is waiting for it anymore
+        destroy(c);
+        return;
+    }
+    idle.push_back(c);
+    if (idle.size()>MAXIDLE) {
+        Code* old= idle.front();
+        idle.erase(idle.begin());
+        destroy(old);
+    }
+}
+
+void MLPNative::poll()
+{
+#ifdef MLPNATIVE_POSIX
+    if (compiling!=NULL) {
+        int st;
+        pid_t p= waitpid(compiling->pid, &st, WNOHANG);
+        if (p==0) return; //still going
+        if (p<0) st= -1;
+        done(compiling, st);
+    }
+    while (compiling==NULL && !queue.empty() && fails<MAXFAILS) {
+        Code* c= queue.front();
+        queue.pop_front();
+        if (!start(c)) {
+            c->status= FAILED;
+            failures++;
+            fails++;
+        }
+    }
+    if (fails>=MAXFAILS && !broken) {
+        const char* cxx= getenv("CXX");
+        printf("MLPNative: could not compile with %s, MLP brains stay interpreted\n", cxx!=NULL && cxx[0]!=0 ? cxx : "c++");
+        broken= true;
+    }
+#endif
+}
+
+void MLPNative::finish()
+{
+#ifdef MLPNATIVE_POSIX
+    while (compiling!=NULL) {
+        int st;
+        pid_t p= waitpid(compiling->pid, &st, 0);
+        if (p<0) st= -1;
+        done(compiling, st);
+        poll();
+    }
+#endif
+}
+
+void MLPNative::tick(const Code* c, char* b, const float* in, float* out)
+{
+    SHAPES[MLPBrain::shape()].tick(c, b, in, out);
+}
@@ -0,0 +1,54 @@
+#ifndef MLPNATIVE_H
+#define MLPNATIVE_H
+
+#include "MLPBrain.h"
+
+/**
+ * Native code for the genome of a long-lived MLP brain. Its boxes are
+ * written out as straight-line C++, with every weight, source box and
+ * synapse type a constant, and compiled by the system compiler ($CXX, else
+ * c++) into a shared object in the background, one at a time, which is
+ * then dlopen'd. The code computes the targets of the boxes before the
+ * sigmoid; the rest of the tick is done here, with the same arithmetic in
+ * the same order as mlpTickBlock, so a brain gives exactly the same results
+ * either way. Brains with the same genome share one Code.
+ * A Code belongs to one genome, so a brain that mutates gets a new one and
+ * runs interpreted until that is ready. If the compiler can't be run or
+ * keeps failing, everything stays interpreted.
+ * Only on POSIX systems; elsewhere available() is false.
+ */
+class MLPNative
+{
+public:
+    struct Code;
+
+    //code for the genome of the brain at b, an MLPBoxesT of the shape in
+    //use: its live boxes, or all of them if full. It may still be compiling,
+    //see ready(). NULL if native code is off. Every request has to be given
+    //back with drop()
+    static Code* request(const char* b, bool full);
+    static void drop(Code* c);
+    static bool ready(const Code* c);
+
+    //picks up finished compiles and starts the next. Main thread only
+    static void poll();
+    //waits for every compile that was requested, for benchmarks
+    static void finish();
+
+    //one tick of b, whose genome c was requested for. Thread safe
+    static void tick(const Code* c, char* b, const float* in, float* out);
+
+    //runtime switch, off by default
+    static void setEnabled(bool on);
+    static bool enabled();
+    static bool available(); //compiled in for this platform
+
+    //totals, for benchmarks
+    static long builds; //compiles that went through
+    static long failures;
+    static double buildseconds; //from start to dlopen, summed over builds
+    static long hits; //requests for a genome that already had code
+    static long ticks; //brain ticks done in native code
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "MutationLog.h"
+
+static const char* KINDNAMES[Mutation::NUMKINDS]= {
+    "bias", "kp", "gw", "weight", "synapse type", "connection", "notted", "box type", "code",
+    "mutrate1", "mutrate2", "clock1", "clock2", "smell", "sound", "hear", "eyesens", "blood", "eyefov", "eyedir"
+};
+
+const char* Mutation::name() const
+{
+    if (kind>=NUMKINDS) return "unknown";
+    return KINDNAMES[kind];
+}
+
+std::vector<Mutation>* MutationLog::collected= NULL;
+
+MutationLog::MutationLog() :
+        count(0)
+{
+}
+
+void MutationLog::record(int kind, int box, int conn, float oldval, float newval)
+{
+    Mutation* m= &ring[count%SIZE];
+    m->kind= kind;
+    m->conn= conn;
+    m->box= box;
+    m->oldval= oldval;
+    m->newval= newval;
+    count++;
+    if (collected!=NULL) collected->push_back(*m);
+}
+
+void MutationLog::clear()
+{
+    count= 0;
+}
+
+int MutationLog::size() const
+{
+    return count<SIZE ? count : SIZE;
+}
+
+int MutationLog::total() const
+{
+    return count;
+}
+
+const Mutation& MutationLog::get(int i) const
+{
+    return ring[(count-size()+i)%SIZE];
+}
+
+void MutationLog::print() const
+{
+    if (count>SIZE) printf("%i mutations, last %i:\n", count, SIZE);
+    for (int i=0;i<size();i++) {
+        const Mutation& m= get(i);
+        printf("%s jiggled: box %i conn %i, %f -> %f\n", m.name(), m.box, m.conn, m.oldval, m.newval);
+    }
+}
+
+void MutationLog::collect(std::vector<Mutation>* all)
+{
+    collected= all;
+}
+
+bool MutationLog::write(FILE* fp, int agentid, const std::vector<Mutation>& all)
+{
+    int n= (int) all.size();
+    int header[3]= {agentid, n, n};
+    if (fwrite(header, sizeof(header), 1, fp)!=1) return false;
+    if (n>0 && fwrite(&all[0], sizeof(Mutation), n, fp)!=(size_t) n) return false;
+    return true;
+}
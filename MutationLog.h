@@ -0,0 +1,66 @@
+#ifndef MUTATIONLOG_H
+#define MUTATIONLOG_H
+
+#include <stdio.h>
+#include <vector>
+
+/**
+ * A single mutation an agent has relative to its parent. Fixed size binary
+ * record, so it can be kept inline and written straight to a file
+ */
+struct Mutation {
+    enum Kind {
+        //brain
+        BIAS, KP, GW, WEIGHT, SYNAPSETYPE, CONNECTION, NOTTED, BOXTYPE, CODE,
+        //agent traits
+        MUTRATE1, MUTRATE2, CLOCK1, CLOCK2, SMELL, SOUND, HEAR, EYESENS, BLOOD, EYEFOV, EYEDIR,
+        NUMKINDS
+    };
+
+    unsigned char kind;
+    unsigned char conn; //which connection of the box, if it applies
+    unsigned short box; //which box of the brain, or which eye
+    float oldval;
+    float newval;
+
+    const char* name() const;
+};
+
+/**
+ * Ring of the last SIZE mutations of an agent, for printSelf. Lives inside
+ * the Agent, so recording costs a few bytes and no allocation. The full list
+ * of a birth, for mutations.dat, is gathered with collect()
+ */
+class MutationLog
+{
+public:
+    static const int SIZE= 8;
+
+    MutationLog();
+
+    void record(int kind, int box, int conn, float oldval, float newval);
+    void clear();
+
+    int size() const; //how many are kept, at most SIZE
+    int total() const; //how many were recorded, including ones that fell out of the ring
+    const Mutation& get(int i) const; //i=0 is the oldest one kept
+
+    void print() const;
+
+    //while all is not NULL, every record() also appends to it, so a birth can
+    //be written out whole however many records fall out of the ring. Not
+    //thread safe, births happen one at a time
+    static void collect(std::vector<Mutation>* all);
+
+    //appends agent id, the number of records (twice: total and kept, both
+    //all.size()) and then the records to fp
+    static bool write(FILE* fp, int agentid, const std::vector<Mutation>& all);
+
+private:
+    static std::vector<Mutation>* collected;
+
+    Mutation ring[SIZE];
+    int count;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "Sigmoid.h"
+
+#include <vector>
+using namespace std;
+
+float SIGMOIDTABLE[SIGMOIDTABLESIZE+1];
+
+//fills the table before main() runs
+static struct SigmoidTableInit {
+    SigmoidTableInit()
+    {
+        for (int i=0;i<=SIGMOIDTABLESIZE;i++) {
+            double x= -SIGMOIDTABLERANGE + i*(2.0*SIGMOIDTABLERANGE/SIGMOIDTABLESIZE);
+            SIGMOIDTABLE[i]= 1.0/(1.0+exp(-x));
+        }
+    }
+} sigmoidtableinit;
+
+static int SIGMOID= SIGMOID_EXACT;
+static const char* NAMES[SIGMOID_KINDS]= {"exact", "poly", "table"};
+
+void setSigmoid(int kind)
+{
+    SIGMOID= kind;
+}
+
+int sigmoidKind()
+{
+    return SIGMOID;
+}
+
+const char* sigmoidName(int kind)
+{
+    return NAMES[kind];
+}
+
+int sigmoidByName(const char* name)
+{
+    for (int k=0;k<SIGMOID_KINDS;k++) {
+        if (strcmp(name, NAMES[k])==0) return k;
+    }
+    return -1;
+}
+
+double sigmoidMaxError(int kind)
+{
+    const int N= 400000;
+    vector<float> x(N+1);
+    double worst= 0;
+    for (int i=0;i<=N;i++) x[i]= -20.0f + i*(40.0f/N);
+    sigmoidArray(kind, &x[0], N+1);
+    for (int i=0;i<=N;i++) {
+        double in= -20.0f + i*(40.0f/N);
+        double err= fabs(x[i] - 1.0/(1.0+exp(-in)));
+        if (err>worst) worst= err;
+    }
+    return worst;
+}
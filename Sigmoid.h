@@ -0,0 +1,79 @@
+#ifndef SIGMOID_H
+#define SIGMOID_H
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * The squashing function of MLPBrain boxes, in three flavours:
+ * exact is the original double precision 1/(1+exp(-x)), poly builds
+ * exp(-x) from a power of two and a polynomial, table interpolates in a
+ * precomputed table. The cheap ones are written so the compiler can
+ * vectorize them over an array (needs -fno-trapping-math, which the build
+ * files pass). Only exact reproduces old runs bit for bit.
+ */
+
+enum SigmoidKind { SIGMOID_EXACT= 0, SIGMOID_POLY, SIGMOID_TABLE, SIGMOID_KINDS };
+
+//runtime switch, exact by default
+void setSigmoid(int kind);
+int sigmoidKind();
+const char* sigmoidName(int kind);
+int sigmoidByName(const char* name); //-1 if there is no such kind
+
+//largest difference to the double precision sigmoid over a dense sweep of [-20,20]
+double sigmoidMaxError(int kind);
+
+const int SIGMOIDTABLESIZE= 2048;
+const float SIGMOIDTABLERANGE= 16; //table covers [-RANGE,RANGE]
+extern float SIGMOIDTABLE[SIGMOIDTABLESIZE+1];
+
+inline float sigmoidExact(float x)
+{
+    return 1.0/(1.0+exp(-x));
+}
+
+inline float sigmoidPoly(float x)
+{
+    //exp(-x) = 2^t = 2^n * 2^f, with n the nearest integer to t and |f|<=0.5
+    float t= -x*1.44269504f;
+    t= t>126 ? 126 : t;
+    t= t<-126 ? -126 : t;
+    int n= (int) (t+126.5f) - 126;
+    float f= t-n;
+    float p= 1.0f + f*(0.693147181f + f*(0.240226507f + f*(0.0555041087f
+           + f*(0.00961812911f + f*(0.00133335581f + f*0.000154035304f)))));
+    int bits= (n+127)<<23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return 1.0f/(1.0f+p*scale);
+}
+
+inline float sigmoidTable(float x)
+{
+    float u= (x+SIGMOIDTABLERANGE)*(SIGMOIDTABLESIZE/(2*SIGMOIDTABLERANGE));
+    u= u<0 ? 0 : u;
+    u= u>SIGMOIDTABLESIZE-1 ? SIGMOIDTABLESIZE-1 : u; //keeps i+1 in the table
+    int i= (int) u;
+    float fr= u-i;
+    return SIGMOIDTABLE[i] + (SIGMOIDTABLE[i+1]-SIGMOIDTABLE[i])*fr;
+}
+
+//x[i]= sigmoid(x[i]) for n values
+inline void sigmoidArray(int kind, float* x, int n)
+{
+    switch (kind) {
+    case SIGMOID_POLY:
+        #pragma omp simd
+        for (int i=0;i<n;i++) x[i]= sigmoidPoly(x[i]);
+        break;
+    case SIGMOID_TABLE:
+        #pragma omp simd
+        for (int i=0;i<n;i++) x[i]= sigmoidTable(x[i]);
+        break;
+    default:
+        for (int i=0;i<n;i++) x[i]= sigmoidExact(x[i]);
+    }
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "Simd.h"
+
+#include <string.h>
+
+static const char* NAMES[SIMD_LEVELS]= {"sse2", "avx2", "avx512"};
+
+static int detect()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    //also checks that the OS saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+            && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq")) return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+#endif
+    return SIMD_SSE2;
+}
+
+static int SUPPORTED= detect();
+static int LEVEL= SUPPORTED;
+
+void setSimdLevel(int level)
+{
+    LEVEL= level<SUPPORTED ? level : SUPPORTED;
+}
+
+int simdLevel()
+{
+    return LEVEL;
+}
+
+int simdSupported()
+{
+    return SUPPORTED;
+}
+
+const char* simdName(int level)
+{
+    return NAMES[level];
+}
+
+int simdByName(const char* name)
+{
+    for (int k=0;k<SIMD_LEVELS;k++) {
+        if (strcmp(name, NAMES[k])==0) return k;
+    }
+    return -1;
+}
@@ -0,0 +1,76 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/**
+ * Instruction sets the hot kernels (brain ticks, sensing, movement) are
+ * built for. The build passes no architecture flags, so the plain code is
+ * SSE2 (the x86-64 baseline); on GCC and clang every kernel is compiled a
+ * second and third time for AVX2 and AVX-512, and simdCall() picks one at
+ * runtime by what the CPU has. None of them use FMA (AVX-512 would fuse
+ * multiplies and adds by default, so that is turned off), so the MLP,
+ * DWRAON and assembly brains and the World give the same results on every
+ * level.
+ * Dense brains sum their dot products in vector order, so those differ by
+ * rounding between levels.
+ * Elsewhere, and on other compilers, there is only the plain level.
+ */
+
+enum SimdLevel { SIMD_SSE2= 0, SIMD_AVX2, SIMD_AVX512, SIMD_LEVELS };
+
+//runtime switch. Starts at the best level the CPU has, and is never set above it
+void setSimdLevel(int level);
+int simdLevel();
+int simdSupported(); //best level of this CPU and build
+const char* simdName(int level);
+int simdByName(const char* name); //-1 if there is no such level
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+//compile a function for a level, with everything it calls inlined into it,
+//so all of that uses those instructions
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2"), flatten))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512vl,avx512bw,avx512dq,prefer-vector-width=512"), optimize("fp-contract=off"), flatten))
+#else
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#endif
+
+//f(a...) with f compiled for simdLevel(). f has to be a function whose
+//address is known at compile time, see SIMD_CALL
+template <class F, F f, class... A>
+SIMD_TARGET_AVX2 void simdAvx2(A... a) { f(a...); }
+
+template <class F, F f, class... A>
+SIMD_TARGET_AVX512 void simdAvx512(A... a) { f(a...); }
+
+template <class F, F f, class... A>
+inline void simdCall(A... a)
+{
+    switch (simdLevel()) {
+    case SIMD_AVX512: simdAvx512<F,f,A...>(a...); break;
+    case SIMD_AVX2: simdAvx2<F,f,A...>(a...); break;
+    default: f(a...);
+    }
+}
+
+#define SIMD_CALL(f, ...) simdCall<decltype(&f), &f>(__VA_ARGS__)
+
+//the same for a member function void T::f(), on t
+template <class T, void (T::*f)()>
+SIMD_TARGET_AVX2 void simdMemberAvx2(T* t) { (t->*f)(); }
+
+template <class T, void (T::*f)()>
+SIMD_TARGET_AVX512 void simdMemberAvx512(T* t) { (t->*f)(); }
+
+template <class T, void (T::*f)()>
+inline void simdCallMember(T* t)
+{
+    switch (simdLevel()) {
+    case SIMD_AVX512: simdMemberAvx512<T,f>(t); break;
+    case SIMD_AVX2: simdMemberAvx2<T,f>(t); break;
+    default: (t->*f)();
+    }
+}
+
+#define SIMD_CALL_MEMBER(T, f, t) simdCallMember<T, &T::f>(t)
+
+#endif
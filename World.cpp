@@ -5,20 +5,36 @@
 #include "settings.h"
 #include "helpers.h"
 #include "vmath.h"
+#include "Simd.h"
 #include <stdio.h>
 
 using namespace std;
 
+static int brainevery= 1;
+
+void World::setBrainEvery(int k)
+{
+    brainevery= k<1 ? 1 : k;
+}
+
+int World::brainEvery()
+{
+    return brainevery;
+}
+
 World::World() :
         modcounter(0),
         current_epoch(0),
         idcounter(0),
         FW(conf::WIDTH/conf::CZ),
         FH(conf::HEIGHT/conf::CZ),
-        CLOSED(false)
+        CLOSED(false),
+        mutlog(NULL)
 {
+    if (conf::MUTATIONLOG) mutlog= fopen("mutations.dat", "ab");
     addRandomBots(conf::NUMBOTS);
     //inititalize food layer
+    food= (float (*)[conf::HEIGHT/conf::CZ]) bulkAlloc(FW*FH*sizeof(float));
 
     for (int x=0;x<FW;x++) {
         for (int y=0;y<FH;y++) {
@@ -31,6 +47,12 @@ World::World() :
     ptr=0;
 }
 
+World::~World()
+{
+    if (mutlog!=NULL) fclose(mutlog);
+    bulkFree(food);
+}
+
 void World::update()
 {
     modcounter++;
@@ -148,9 +170,10 @@ void World::update()
 
         }
     }
-    vector<Agent>::iterator iter= agents.begin();
+    vector<Agent, BulkAllocator<Agent> >::iterator iter= agents.begin();
     while (iter != agents.end()) {
         if (iter->health <=0) {
+            if (iter->brainslot!=-1) brainarena.release(iter->brainslot);
             iter= agents.erase(iter);
         } else {
             ++iter;
@@ -186,6 +209,16 @@ void World::update()
 }
 
 void World::setInputs()
+{
+    SIMD_CALL_MEMBER(World, setInputsKernel, this);
+}
+
+void World::processOutputs()
+{
+    SIMD_CALL_MEMBER(World, processOutputsKernel, this);
+}
+
+void World::setInputsKernel()
 {
     //P1 R1 G1 B1 FOOD P2 R2 G2 B2 SOUND SMELL HEALTH P3 R3 G3 B3 CLOCK1 CLOCK 2 HEARING     BLOOD_SENSOR   TEMPERATURE_SENSOR
     //0   1  2  3  4   5   6  7 8   9     10     11   12 13 14 15 16       17      18           19                 20
@@ -314,7 +347,7 @@ void World::setInputs()
     }
 }
 
-void World::processOutputs()
+void World::processOutputsKernel()
 {
     //assign meaning
     //LEFT RIGHT R G B SPIKE BOOST SOUND_MULTIPLIER GIVING
@@ -464,20 +497,197 @@ void World::processOutputs()
 
 void World::brainsTick()
 {
+    //MLP brains: the arena ticks them by slot, a block of them at a time
+    vector<vector<float>*> ins(brainarena.capacity(), (vector<float>*) NULL);
+    vector<vector<float>*> outs(brainarena.capacity(), (vector<float>*) NULL);
+    //the other types are ticked a group per type, each with its own kernel
+    vector<int> dwraon, assembly;
+    vector<DenseBrain*> dense;
+    vector<vector<float>*> densein, denseout;
+    int shown= -1; //the view draws every box of the selected agent, so it can't be pruned
+    int now= current_epoch*10000 + modcounter; //modcounter starts over every epoch
+    for (int i=0;i<agents.size();i++) {
+        if (agents[i].selectflag) shown= agents[i].brainslot;
+        //brains that are not due keep their outputs from the last tick they had.
+        //MLP brains take turns by arena block, which is ticked whole or not at all
+        int turn= agents[i].brainslot!=-1 ? agents[i].brainslot/BrainArena::LANES : agents[i].id;
+        if (brainevery>1 && (turn+now)%brainevery!=0) continue;
+        switch (agents[i].brain.type()) {
+        case AgentBrain::DWRAON: dwraon.push_back(i); break;
+        case AgentBrain::ASSEMBLY: assembly.push_back(i); break;
+        case AgentBrain::DENSE:
+            dense.push_back(&agents[i].brain.dense());
+            densein.push_back(&agents[i].in);
+            denseout.push_back(&agents[i].out);
+            break;
+        default:
+            ins[agents[i].brainslot]= &agents[i].in;
+            outs[agents[i].brainslot]= &agents[i].out;
+        }
+    }
+
+    brainarena.setShown(shown);
+    if (!ins.empty()) brainarena.tickAll(&ins[0], &outs[0]);
+
     #pragma omp parallel for
+    for (int k=0;k<dwraon.size();k++) {
+        Agent& a= agents[dwraon[k]];
+        a.brain.dwraon().tick(a.in, a.out);
+    }
+
+    #pragma omp parallel for
+    for (int k=0;k<assembly.size();k++) {
+        Agent& a= agents[assembly[k]];
+        a.brain.assembly().tick(a.in, a.out);
+    }
+
+    if (!dense.empty()) DenseBrain::tickAll(&dense[0], &densein[0], &denseout[0], dense.size());
+}
+
+void World::addAgent(Agent& a)
+{
+    a.id= idcounter;
+    idcounter++;
+    if (a.brain.type()==AgentBrain::MLP) {
+        a.brainslot= brainarena.alloc();
+        brainarena.load(a.brainslot, a.brain.mlp());
+#ifdef COMPACT_AGENTS
+        //the arena copy is the only one. Births bring it back into the Agent for a moment
+        a.brain.mlp().release();
+#endif
+    } else {
+        a.brainslot= -1;
+    }
+    agents.push_back(std::move(a));
+}
+
+void World::fetchBrain(Agent& a)
+{
+    if (a.brainslot!=-1) brainarena.store(a.brainslot, a.brain.mlp());
+}
+
+void World::dropBrain(Agent& a)
+{
+#ifdef COMPACT_AGENTS
+    if (a.brainslot!=-1) a.brain.mlp().release();
+#else
+    (void) a; //the Agent keeps its copy
+#endif
+}
+
+const BrainArena& World::brainArena() const
+{
+    return brainarena;
+}
+
+void World::saveBrainStates(BrainCheckpoint& c) const
+{
+    c.ids.resize(agents.size());
+    c.state.clear();
     for (int i=0;i<agents.size();i++) {
-        agents[i].tick();
+        const Agent& a= agents[i];
+        c.ids[i]= a.id;
+        size_t at= c.state.size();
+        c.state.resize(at+a.brain.stateSize());
+        //MLP brains run in the arena, the Agent's copy may be out of date
+        if (a.brainslot!=-1) brainarena.saveState(a.brainslot, &c.state[at]);
+        else a.brain.saveState(&c.state[at]);
+    }
+}
+
+bool World::restoreBrainStates(const BrainCheckpoint& c)
+{
+    if (c.ids.size()!=agents.size()) return false;
+    size_t size= 0;
+    for (int i=0;i<agents.size();i++) {
+        if (c.ids[i]!=agents[i].id) return false;
+        size+= agents[i].brain.stateSize();
+    }
+    if (c.state.size()!=size) return false;
+
+    const float* p= c.state.data();
+    for (int i=0;i<agents.size();i++) {
+        Agent& a= agents[i];
+        if (a.brainslot!=-1) brainarena.restoreState(a.brainslot, p);
+        else a.brain.restoreState(p);
+        p+= a.brain.stateSize();
+    }
+    return true;
+}
+
+void World::printMemoryReport() const
+{
+    int n= agents.size();
+    if (n==0) return;
+
+    AgentMemory sum;
+    for (int i=0;i<n;i++) {
+        AgentMemory m= agents[i].memoryUsage();
+        sum.brain+= m.brain;
+        sum.sensors+= m.sensors;
+        sum.mutations+= m.mutations;
+        sum.traits+= m.traits;
+        sum.overhead+= m.overhead;
     }
+    sum.arena= brainarena.used()*brainarena.slotBytes(); //only MLP brains have a slot
+
+#ifdef COMPACT_AGENTS
+    printf("Memory per agent, average of %i agents (compact agents: brain lives only in the arena):\n", n);
+#else
+    printf("Memory per agent, average of %i agents:\n", n);
+#endif
+    printf("  brain            %8zu bytes\n", sum.brain/n);
+    printf("  brain arena slot %8zu bytes\n", sum.arena/n);
+    printf("  sensors          %8zu bytes\n", sum.sensors/n);
+    printf("  mutation log     %8zu bytes\n", sum.mutations/n);
+    printf("  other traits     %8zu bytes\n", sum.traits/n);
+    printf("  malloc overhead  %8zu bytes\n", sum.overhead/n);
+    printf("  total            %8zu bytes (%.1f KB)\n", sum.total()/n, sum.total()/n/1024.0);
+
+    //slack that belongs to the population rather than to any one agent
+    size_t slack= (agents.capacity()-n)*sizeof(Agent) + (brainarena.capacity()-brainarena.used())*brainarena.slotBytes();
+    printf("Unused capacity in agents[] and arena: %zu bytes. Whole population: %.2f MB\n", slack, (sum.total()+slack)/(1024.0*1024.0));
+
+    int slots= brainarena.used();
+    if (slots>0) {
+        long boxes, synapses;
+        brainarena.planStats(boxes, synapses);
+        printf("MLP brains compute %.1f of %i boxes, with %.1f of %i synapses nonzero, on average (pruning %s)\n",
+               (double) boxes/slots, MLPBrain::boxes()-INPUTSIZE, (double) synapses/slots, (MLPBrain::boxes()-INPUTSIZE)*MLPBrain::conns(),
+               BrainArena::pruning() ? "on" : "off");
+        printf("MLP block genomes: %zu bytes per brain, %i bit weights\n", brainarena.blockBytes()/BrainArena::LANES, brainarena.blockWeightBits());
+    }
+
+    long chunks, refs;
+    MLPBrain::chunkStats(chunks, refs);
+    if (chunks>0) {
+        printf("MLP genome chunks: %li held by %li brain references, %.1f KB saved by sharing\n",
+               chunks, refs, (refs-chunks)*MLPBrain::chunkBytes()/1024.0);
+    }
+}
+
+//deep brain copies made so far, of all brain types. The birth
+//paths below compare this before and after to make sure newborns are moved
+//into agents[] and never copied
+static long brainCopies()
+{
+    return AgentBrain::copies();
+}
+
+static void checkBrainCopies(const char* where, long before, long allowed)
+{
+    long made= brainCopies()-before;
+    if (made>allowed) printf("WARNING: %s made %li deep brain copies, expected at most %li\n", where, made, allowed);
 }
 
 void World::addRandomBots(int num)
 {
+    long copies= brainCopies();
     for (int i=0;i<num;i++) {
         Agent a;
-        a.id= idcounter;
-        idcounter++;
-        agents.push_back(a);
+        addAgent(a);
     }
+    checkBrainCopies("addRandomBots", copies, 0);
 }
 
 void World::positionOfInterest(int type, float &xi, float &yi) {
@@ -509,19 +719,15 @@ void World::positionOfInterest(int type, float &xi, float &yi) {
 void World::addCarnivore()
 {
     Agent a;
-    a.id= idcounter;
-    idcounter++;
     a.herbivore= randf(0, 0.1);
-    agents.push_back(a);
+    addAgent(a);
 }
 
 void World::addHerbivore()
 {
     Agent a;
-    a.id= idcounter;
-    idcounter++;
     a.herbivore= randf(0.9, 1);
-    agents.push_back(a);
+    addAgent(a);
 }
 
 
@@ -544,14 +750,19 @@ void World::addNewByCrossover()
     Agent* a2= &agents[i2];
 
 
-    //cross brains
+    //cross brains. The child brain starts out as a copy of a1's, that's the only one
+    //the parents' brain state is live in the arena, bring it back first so the child inherits it
+    fetchBrain(*a1);
+    fetchBrain(*a2);
+    long copies= brainCopies();
     Agent anew = a1->crossover(*a2);
 
 
     //maybe do mutation here? I dont know. So far its only crossover
-    anew.id= idcounter;
-    idcounter++;
-    agents.push_back(anew);
+    addAgent(anew);
+    checkBrainCopies("addNewByCrossover", copies, 1);
+    dropBrain(agents[i1]);
+    dropBrain(agents[i2]);
 }
 
 void World::reproduce(int ai, float MR, float MR2)
@@ -560,12 +771,19 @@ void World::reproduce(int ai, float MR, float MR2)
     if (randf(0,1)<0.04) MR2= MR2*randf(1, 10);
 
     agents[ai].initEvent(30,0,0.8,0); //green event means agent reproduced.
+    fetchBrain(agents[ai]); //babies copy the live brain state too
+    long copies= brainCopies();
     for (int i=0;i<conf::BABIES;i++) {
 
+        //the agent keeps only its last few mutations, so the file gets the whole list
+        if (mutlog!=NULL) {
+            newmutations.clear();
+            MutationLog::collect(&newmutations);
+        }
         Agent a2 = agents[ai].reproduce(MR,MR2);
-        a2.id= idcounter;
-        idcounter++;
-        agents.push_back(a2);
+        MutationLog::collect(NULL);
+        addAgent(a2);
+        if (mutlog!=NULL) MutationLog::write(mutlog, agents.back().id, newmutations);
 
         //TODO fix recording
         //record this
@@ -573,6 +791,9 @@ void World::reproduce(int ai, float MR, float MR2)
         //fprintf(fp, "%i %i %i\n", 1, this->id, a2.id); //1 marks the event: child is born
         //fclose(fp);
     }
+    //each baby gets exactly one copy of the parent brain, which it then mutates
+    checkBrainCopies("reproduce", copies, conf::BABIES);
+    dropBrain(agents[ai]);
 }
 
 void World::writeReport()
@@ -600,6 +821,7 @@ void World::writeReport()
 void World::reset()
 {
     agents.clear();
+    brainarena.clear();
     addRandomBots(conf::NUMBOTS);
 }
 
@@ -648,7 +870,7 @@ void World::draw(View* view, bool drawfood)
     }
     
     //draw all agents
-    vector<Agent>::const_iterator it;
+    vector<Agent, BulkAllocator<Agent> >::const_iterator it;
     for ( it = agents.begin(); it != agents.end(); ++it) {
         view->drawAgent(*it);
     }
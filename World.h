@@ -3,8 +3,17 @@
 
 #include "View.h"
 #include "Agent.h"
+#include "BrainArena.h"
+#include "BulkAlloc.h"
 #include "settings.h"
 #include <vector>
+#include <stdio.h>
+//the brain state of every agent at one moment, see World::saveBrainStates
+struct BrainCheckpoint {
+    std::vector<int> ids; //of the agents, in order
+    std::vector<float> state; //their brain states one after the other
+};
+
 class World
 {
 public:
@@ -39,33 +48,55 @@ public:
     void addHerbivore();
     
     void positionOfInterest(int type, float &xi, float &yi);
+
+    const BrainArena& brainArena() const;
+    void printMemoryReport() const; //bytes per agent, broken down
+    //checkpoint of the state of every brain, agent by agent, without their genomes.
+    //Restoring fails unless the agents are the ones it was taken of
+    void saveBrainStates(BrainCheckpoint& c) const;
+    bool restoreBrainStates(const BrainCheckpoint& c);
+
+    //runtime switch: tick each brain every k-th world tick only, staggered by
+    //agent (by arena block for MLP brains), and hold its outputs in between. Sensing and movement still
+    //run every tick. 1, the default, ticks every brain every tick
+    static void setBrainEvery(int k);
+    static int brainEvery();
     
     std::vector<int> numCarnivore;
     std::vector<int> numHerbivore; 
     int ptr;
     
 private:
-    void setInputs();
-    void processOutputs();
+    void setInputs(); //sensing
+    void processOutputs(); //movement and the rest the outputs drive
+    void setInputsKernel(); //what the two do, built for every SIMD level (see Simd.h)
+    void processOutputsKernel();
     void brainsTick();  //takes in[] to out[] for every agent
     
     void writeReport();
     
     void reproduce(int ai, float MR, float MR2);
+    void addAgent(Agent &a); //gives a an id and a brain slot if it has an MLP brain, then moves it into agents[]
+    void fetchBrain(Agent &a); //bring the live arena copy of a's brain back into a.brain
+    void dropBrain(Agent &a); //COMPACT_AGENTS: let go of a.brain again once it's not needed
     
     int modcounter;
     int current_epoch;
     int idcounter;
     
-    std::vector<Agent> agents;
+    std::vector<Agent, BulkAllocator<Agent> > agents;
+    BrainArena brainarena; //running brains of all agents, indexed by Agent::brainslot
     
     // food
     int FW;
     int FH;
     int fx;
     int fy;
-    float food[conf::WIDTH/conf::CZ][conf::HEIGHT/conf::CZ];
+    float (*food)[conf::HEIGHT/conf::CZ]; //[FW][FH], in one bulkAlloc'd block
     bool CLOSED; //if environment is closed, then no random bots are added per time interval
+    
+    FILE* mutlog; //where newborns' mutations are streamed to, if conf::MUTATIONLOG
+    std::vector<Mutation> newmutations; //all mutations of the baby being born, for mutlog
 };
 
 #endif // WORLD_H
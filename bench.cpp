@@ -0,0 +1,503 @@
+/*
+Headless benchmark. Runs the World without any GLUT window for a fixed
+number of ticks and prints one line of key=value pairs per run, so results
+are easy to collect from scripts.
+
+    sbbench [-ticks N] [-agents N] [-seed N] [-hugepages on|off|both]
+            [-sigmoid exact|poly|table|all] [-shape 200x4|500x8|...|all]
+            [-brain mlp|dwraon|assembly|dense|mixed] [-jit on|off|both] [-asmjit]
+            [-prune on|off|both] [-weights float|int16|int8|all] [-births N]
+            [-simd sse2|avx2|avx512|best|all] [-native on|off|both]
+            [-brainevery K[,K...]]
+
+checksum= is computed from the final state of all agents and the food. Two
+builds that simulate the same thing print the same checksum for a seed.
+sigmoid_error= is the largest difference of the brain sigmoid in use to
+the double precision one, so its speed can be weighed against its accuracy.
+-shape runs the MLP brains in another of the shapes of BrainShapes.h, all
+runs each of them. shape= is the one a run used.
+-jit turns the native code of assembly brains on or off (see AsmJit.h).
+-prune on leaves out computing the MLP boxes that can't reach the outputs
+(see BrainArena.h), which changes the checksum. live_boxes= and
+live_synapses= are what the MLP brains at the end compute per tick on
+average, of brain_boxes= and brain_synapses=.
+state_bytes= is the brain state of an agent at the end, without its genome,
+checkpoint_us= how long taking it for all agents takes, and checkpoint=ok
+says restoring it and taking it again gave the same.
+-weights picks how the MLP block genomes keep their weights (see
+BrainArena.h). plan_bytes= is what that takes per brain. For int16 and int8
+quant_error= is the largest difference in one tick of the outputs of random
+brains to float weights, quant_bound= the most it may be for them.
+-births skips the World too and has one agent of the -brain type give birth
+N times, printing births_per_sec= for the whole of Agent::reproduce and
+mutate_ns= for the brain mutation alone, at that agent's mutation rate,
+and crossover_ns= for a brain crossover with a second agent. For mlp brains
+it also prints the genome and state bytes copied per birth (copy-on-write,
+see MLPBrain.h) and, with the last 1000 babies kept alive, how many genome
+chunks they and the parent share and the memory that saves.
+-simd picks the instruction set of the brain and World kernels (see
+Simd.h), best being the best the CPU has; all runs every level it has.
+simd= is the level a run used.
+-native compiles the genomes of MLP brains that live MLPNATIVETICKS ticks
+(see settings.h) to native code in the background (see MLPNative.h).
+native_builds= and native_compile_ms= are the compiles of a run and what
+one takes on average from start to dlopen, native_hits= the brains that
+found the code for their genome already built, native_ticks= the brain
+ticks it ran. The checksum is the same as without.
+-brainevery 1,2,4 ticks each brain only every K-th tick, holding its
+outputs in between (see World::setBrainEvery), with brain_every= on the
+line. Given a K other than 1 it first runs K=1 as the reference, and
+quietly once more with seed+1, then prints a fidelity line after each
+other K: speedup= over the reference, and for the number of agents, of
+herbivores, their mean health and mean generation sampled every 100
+ticks, the difference to the reference relative to it (agents_error= and
+so on). The simulation is chaotic, so runs drift apart whatever changes.
+The noise_ keys are the same differences between the two reference runs,
+what a different seed alone does.
+-asmjit skips the World too and weighs that native code up on its own: it
+ticks that many random assembly brains, on one thread, interpreted and then
+native, and prints what a compile costs against what a tick saves, with
+the number of ticks a brain must live to earn its compile back and the net
+saving over a lifetime of -ticks ticks.
+*/
+
+#include "World.h"
+#include "BulkAlloc.h"
+#include "Sigmoid.h"
+#include "BrainShapes.h"
+#include "Simd.h"
+#include "MLPNative.h"
+#include "AssemblyBrain.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//counts data TLB misses of this process (all threads) through perf events
+class TLBCounter
+{
+public:
+    TLBCounter() : fd(-1)
+    {
+#ifdef __linux__
+        struct perf_event_attr pe;
+        memset(&pe, 0, sizeof(pe));
+        pe.type= PERF_TYPE_HW_CACHE;
+        pe.size= sizeof(pe);
+        pe.config= PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ<<8) | (PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+        pe.disabled= 1;
+        pe.exclude_kernel= 1;
+        pe.exclude_hv= 1;
+        pe.inherit= 1; //include OpenMP worker threads created later
+        fd= syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0);
+#endif
+    }
+    ~TLBCounter()
+    {
+#ifdef __linux__
+        if (fd!=-1) close(fd);
+#endif
+    }
+
+    void start()
+    {
+#ifdef __linux__
+        if (fd==-1) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    //misses since start(), or -1 if the counter isn't available here
+    long long stop()
+    {
+#ifdef __linux__
+        if (fd==-1) return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count;
+        if (read(fd, &count, sizeof(count))!=sizeof(count)) return -1;
+        return count;
+#else
+        return -1;
+#endif
+    }
+
+private:
+    int fd;
+};
+
+//a View that draws nothing and just sums up what it is shown
+class ChecksumView : public View
+{
+public:
+    ChecksumView() : sum(0) {}
+
+    virtual void drawAgent(const Agent &a)
+    {
+        sum+= a.pos.x + 3*a.pos.y + 5*a.health + 7*a.angle;
+        for (int i=0;i<OUTPUTSIZE;i++) sum+= a.out[i]*(i+1);
+    }
+    virtual void drawFood(int x, int y, float quantity) { sum+= quantity*(x+y*conf::WIDTH/conf::CZ+1); }
+    virtual void drawMisc() {}
+
+    double sum;
+};
+
+static const char* weightsName(int bits)
+{
+    if (bits==16) return "int16";
+    if (bits==8) return "int8";
+    return "float";
+}
+
+//population sampled every DYNSAMPLE ticks of a run, for -brainevery
+const int DYNSAMPLE= 100;
+struct Dynamics {
+    std::vector<double> agents, herbivores, health, generation;
+    double secs;
+};
+
+//a View that sums up the health and generation of the agents
+class DynamicsView : public View
+{
+public:
+    DynamicsView() : health(0), generation(0) {}
+
+    virtual void drawAgent(const Agent &a)
+    {
+        health+= a.health;
+        generation+= a.gencount;
+    }
+    virtual void drawFood(int, int, float) {}
+    virtual void drawMisc() {}
+
+    double health, generation;
+};
+
+static void sample(World* world, Dynamics& d)
+{
+    DynamicsView view;
+    world->draw(&view, false);
+    int n= world->numAgents();
+    d.agents.push_back(n);
+    d.herbivores.push_back(world->numHerbCarnivores().first);
+    d.health.push_back(n>0 ? view.health/n : 0);
+    d.generation.push_back(n>0 ? view.generation/n : 0);
+}
+
+//dyn, if given, gets the population every DYNSAMPLE ticks. Prints the
+//result line unless quiet
+static void run(int ticks, int numagents, int seed, bool huge, int sigmoid, Dynamics* dyn= NULL, bool quiet= false)
+{
+    long builds0= AsmJit::builds, exits0= AsmJit::exits;
+    double buildsecs0= AsmJit::buildseconds;
+    long nbuilds0= MLPNative::builds, nhits0= MLPNative::hits, nticks0= MLPNative::ticks;
+    double nsecs0= MLPNative::buildseconds;
+    setHugePages(huge);
+    setSigmoid(sigmoid);
+    srand(seed);
+
+    World* world= new World();
+    if (world->numAgents()<numagents) world->addRandomBots(numagents-world->numAgents());
+
+    TLBCounter tlb;
+    std::chrono::steady_clock::time_point t0= std::chrono::steady_clock::now();
+    tlb.start();
+    for (int i=0;i<ticks;i++) {
+        world->update();
+        if (dyn!=NULL && (i+1)%DYNSAMPLE==0) sample(world, *dyn);
+    }
+    long long misses= tlb.stop();
+    double secs= std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    if (dyn!=NULL) dyn->secs= secs;
+
+    ChecksumView view;
+    world->draw(&view, true);
+
+    long boxes, synapses;
+    world->brainArena().planStats(boxes, synapses);
+    int slots= world->brainArena().used();
+    if (slots==0) slots= 1;
+
+    size_t planbytes= world->brainArena().blockBytes()/BrainArena::LANES;
+    int planbits= world->brainArena().blockWeightBits();
+
+    //checkpoint the brain states, restore them and take them again, which
+    //has to give the same
+    BrainCheckpoint c1, c2;
+    t0= std::chrono::steady_clock::now();
+    world->saveBrainStates(c1);
+    double savesecs= std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    bool restored= world->restoreBrainStates(c1);
+    world->saveBrainStates(c2);
+    restored= restored && c1.state==c2.state;
+    int agentsend= world->numAgents();
+    delete world;
+
+    double bound;
+    srand(seed);
+    double qerr= quantError(planbits, numagents, 200, bound);
+
+    long builds= AsmJit::builds-builds0;
+    long nbuilds= MLPNative::builds-nbuilds0;
+    if (quiet) return;
+    printf("brain=%s shape=%s simd=%s jit=%s prune=%s brain_boxes=%i live_boxes=%.1f brain_synapses=%i live_synapses=%.1f weights=%s plan_bytes=%zu quant_error=%.3g quant_bound=%.3g hugepages=%s sigmoid=%s sigmoid_error=%.3g ticks=%i agents_start=%i agents_end=%i seconds=%.3f ticks_per_sec=%.1f dtlb_misses=%lld jit_builds=%ld jit_compile_us=%.2f jit_exits=%ld native=%s native_builds=%ld native_compile_ms=%.1f native_hits=%ld native_ticks=%ld brain_every=%i state_bytes=%.1f checkpoint_us=%.1f checkpoint=%s checksum=%.6f\n",
+           AgentBrain::typeName(AgentBrain::defaultType()), brainShapeAt(MLPBrain::shape()).name, simdName(simdLevel()), AsmJit::enabled() ? "on" : "off", BrainArena::pruning() ? "on" : "off",
+           MLPBrain::boxes()-INPUTSIZE, (double) boxes/slots, (MLPBrain::boxes()-INPUTSIZE)*MLPBrain::conns(), (double) synapses/slots,
+           weightsName(planbits), planbytes, qerr, bound, huge ? "on" : "off", sigmoidName(sigmoid), sigmoidMaxError(sigmoid), ticks, numagents, agentsend, secs, ticks/secs, misses,
+           builds, builds>0 ? (AsmJit::buildseconds-buildsecs0)*1e6/builds : 0.0, AsmJit::exits-exits0,
+           MLPNative::enabled() ? "on" : "off", nbuilds, nbuilds>0 ? (MLPNative::buildseconds-nsecs0)*1e3/nbuilds : 0.0, MLPNative::hits-nhits0, MLPNative::ticks-nticks0, World::brainEvery(),
+           agentsend>0 ? (double) c1.state.size()*sizeof(float)/agentsend : 0.0, savesecs*1e6, restored ? "ok" : "failed", view.sum);
+}
+
+//sum of |a-b| over sum of |b|, for trajectories sampled alike
+static double relError(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double diff= 0, ref= 0;
+    for (size_t i=0;i<a.size() && i<b.size();i++) {
+        diff+= fabs(a[i]-b[i]);
+        ref+= fabs(b[i]);
+    }
+    return ref>0 ? diff/ref : 0;
+}
+
+//run() for every K of every, see -brainevery
+static void runEvery(const std::vector<int>& every, int ticks, int numagents, int seed, bool huge, int sigmoid)
+{
+    World::setBrainEvery(1);
+    if (every.size()==1 && every[0]==1) {
+        run(ticks, numagents, seed, huge, sigmoid);
+        return;
+    }
+
+    Dynamics ref, noise;
+    run(ticks, numagents, seed, huge, sigmoid, &ref);
+    run(ticks, numagents, seed+1, huge, sigmoid, &noise, true);
+    for (size_t i=0;i<every.size();i++) {
+        if (every[i]==1) continue;
+        World::setBrainEvery(every[i]);
+        Dynamics d;
+        run(ticks, numagents, seed, huge, sigmoid, &d);
+        printf("fidelity brain_every=%i speedup=%.3f agents_error=%.3f herbivores_error=%.3f health_error=%.3f generation_error=%.3f noise_agents_error=%.3f noise_herbivores_error=%.3f noise_health_error=%.3f noise_generation_error=%.3f\n",
+               every[i], ref.secs/d.secs, relError(d.agents, ref.agents), relError(d.herbivores, ref.herbivores), relError(d.health, ref.health), relError(d.generation, ref.generation),
+               relError(noise.agents, ref.agents), relError(noise.herbivores, ref.herbivores), relError(noise.health, ref.health), relError(noise.generation, ref.generation));
+    }
+    World::setBrainEvery(1);
+}
+
+//switches the MLP brains to shape i of BrainShapes.h if -shape picks it.
+//Without -shape only the default runs
+static bool pickShape(const char* shape, int i)
+{
+    if (shape==NULL ? i!=0 : strcmp(shape, "all")!=0 && strcmp(shape, brainShapeAt(i).name)!=0) return false;
+    if (MLPBrain::setShape(i)) return true;
+    printf("shape=%s can't be set while MLP brains are alive\n", brainShapeAt(i).name);
+    return false;
+}
+
+static void runBirths(int births, int seed)
+{
+    srand(seed);
+    Agent parent;
+    float MR= parent.MUTRATE1, MR2= parent.MUTRATE2;
+
+    //the last KEEP babies stay alive, so their MLP genomes share chunks with the parent
+    const int KEEP= 1000;
+    std::vector<Agent> kept;
+    kept.reserve(KEEP);
+    long mutations= 0;
+    long long copied0= MLPBrain::bytescopied;
+    std::chrono::steady_clock::time_point t0= std::chrono::steady_clock::now();
+    for (int i=0;i<births;i++) {
+        Agent baby= parent.reproduce(MR, MR2);
+        mutations+= baby.mutations.total();
+        if ((int) kept.size()<KEEP) kept.push_back(std::move(baby));
+        else kept[i%KEEP]= std::move(baby);
+    }
+    double secs= std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    long long copied= MLPBrain::bytescopied-copied0;
+    long chunks, refs;
+    MLPBrain::chunkStats(chunks, refs);
+
+    AgentBrain brain= parent.brain;
+    t0= std::chrono::steady_clock::now();
+    for (int i=0;i<births;i++) brain.mutate(MR, MR2);
+    double mutsecs= std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+
+    Agent mate;
+    t0= std::chrono::steady_clock::now();
+    for (int i=0;i<births;i++) {
+        AgentBrain child= parent.brain.crossover(mate.brain);
+    }
+    double crosssecs= std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+
+    printf("births brain=%s births=%i mutrate=%.4f mutations_per_birth=%.2f seconds=%.3f births_per_sec=%.1f mutate_ns=%.1f crossover_ns=%.1f\n",
+           AgentBrain::typeName(AgentBrain::defaultType()), births, MR, (double) mutations/births, secs, births/secs, mutsecs*1e9/births, crosssecs*1e9/births);
+    if (AgentBrain::defaultType()==AgentBrain::MLP) {
+        printf("births shape=%s genome_bytes_per_brain=%zu bytes_copied_per_birth=%.1f kept=%i chunks=%li chunk_refs=%li saved_kb=%.1f\n",
+               brainShapeAt(MLPBrain::shape()).name, MLPBrain::brainBytes(), (double) copied/births, (int) kept.size(),
+               chunks, refs, (refs-chunks)*MLPBrain::chunkBytes()/1024.0);
+    }
+}
+
+//ticks numagents random assembly brains with fixed random inputs. Returns seconds
+static double tickAssembly(int ticks, int numagents, int seed)
+{
+    srand(seed);
+    std::vector<AssemblyBrain> brains(numagents);
+    std::vector<std::vector<float> > ins(numagents, std::vector<float>(INPUTSIZE));
+    std::vector<float> out(OUTPUTSIZE);
+    for (int a=0;a<numagents;a++) {
+        for (int i=0;i<INPUTSIZE;i++) ins[a][i]= randf(0,1);
+    }
+
+    std::chrono::steady_clock::time_point t0= std::chrono::steady_clock::now();
+    for (int t=0;t<ticks;t++) {
+        for (int a=0;a<numagents;a++) brains[a].tick(ins[a], out);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+static void runAsmJit(int ticks, int numagents, int seed)
+{
+    if (!AsmJit::available()) {
+        printf("asmjit=unavailable\n");
+        return;
+    }
+    AsmJit::setEnabled(false);
+    double interp= tickAssembly(ticks, numagents, seed)*1e9/((double) ticks*numagents);
+
+    AsmJit::setEnabled(true);
+    long builds0= AsmJit::builds, exits0= AsmJit::exits;
+    double buildsecs0= AsmJit::buildseconds;
+    double native= tickAssembly(ticks, numagents, seed)*1e9/((double) ticks*numagents);
+    long builds= AsmJit::builds-builds0;
+    double compile= builds>0 ? (AsmJit::buildseconds-buildsecs0)*1e9/builds : 0; //ns
+
+    //per brain: what its ticks save, less what its compiles cost
+    double saving= interp-native; //includes the compiles, which tickAssembly timed too
+    double perbrain= (double) builds/numagents;
+    double tickgain= saving + compile*perbrain/ticks; //per tick, compiles left out
+    printf("asmjit ticks=%i agents=%i builds=%ld builds_per_brain=%.2f compile_us=%.2f exits=%ld interp_ns_per_tick=%.1f jit_ns_per_tick=%.1f saving_ns_per_tick=%.1f break_even_ticks=%.0f lifetime_saving_us=%.1f\n",
+           ticks, numagents, builds, perbrain, compile/1000, AsmJit::exits-exits0, interp, native, tickgain,
+           tickgain>0 ? compile/tickgain : -1.0, saving*ticks/1000);
+}
+
+//comma separated positive numbers into v. False if there are none or one is not
+static bool parseList(const char* s, std::vector<int>& v)
+{
+    v.clear();
+    while (*s) {
+        char* end;
+        long x= strtol(s, &end, 10);
+        if (end==s || x<=0) return false;
+        v.push_back((int) x);
+        s= end;
+        if (*s==',') s++;
+    }
+    return !v.empty();
+}
+
+int main(int argc, char **argv)
+{
+    int ticks= 2000;
+    int numagents= conf::NUMBOTS;
+    int seed= 1;
+    const char* huge= "off";
+    const char* sigmoid= "exact";
+    const char* shape= NULL;
+    const char* jit= "on";
+    const char* prune= "off";
+    const char* weights= "float";
+    const char* simd= "best";
+    const char* native= "off";
+    std::vector<int> every(1, 1);
+    bool asmjit= false;
+    int births= 0;
+
+    for (int i=1;i<argc;i++) {
+        if (i+1<argc && strcmp(argv[i], "-ticks")==0) ticks= atoi(argv[++i]);
+        else if (i+1<argc && strcmp(argv[i], "-agents")==0) numagents= atoi(argv[++i]);
+        else if (i+1<argc && strcmp(argv[i], "-seed")==0) seed= atoi(argv[++i]);
+        else if (i+1<argc && strcmp(argv[i], "-hugepages")==0) huge= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-sigmoid")==0) sigmoid= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-shape")==0) shape= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-brain")==0 && AgentBrain::typeByName(argv[i+1])!=-2) AgentBrain::setDefaultType(AgentBrain::typeByName(argv[++i]));
+        else if (i+1<argc && strcmp(argv[i], "-jit")==0) jit= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-prune")==0) prune= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-weights")==0) weights= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-births")==0) births= atoi(argv[++i]);
+        else if (i+1<argc && strcmp(argv[i], "-simd")==0) simd= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-native")==0) native= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-brainevery")==0 && parseList(argv[i+1], every)) i++;
+        else if (strcmp(argv[i], "-asmjit")==0) asmjit= true;
+        else {
+            printf("usage: %s [-ticks N] [-agents N] [-seed N] [-hugepages on|off|both] [-sigmoid exact|poly|table|all] [-shape NAME|all] [-brain mlp|dwraon|assembly|dense|mixed] [-jit on|off|both] [-asmjit] [-prune on|off|both] [-weights float|int16|int8|all] [-births N] [-simd sse2|avx2|avx512|best|all] [-native on|off|both] [-brainevery K[,K...]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (strcmp(simd, "best")!=0 && strcmp(simd, "all")!=0) {
+        int s= simdByName(simd);
+        if (s==-1) {
+            printf("unknown simd level %s\n", simd);
+            return 1;
+        }
+        if (s>simdSupported()) printf("simd level %s is not supported here, using %s\n", simd, simdName(simdSupported()));
+        setSimdLevel(s);
+    }
+    if (shape!=NULL && strcmp(shape, "all")!=0 && brainShapeByName(shape)==-1) {
+        printf("unknown brain shape %s\n", shape);
+        return 1;
+    }
+
+    if (asmjit) {
+        runAsmJit(ticks, numagents, seed);
+        return 0;
+    }
+    if (births>0) {
+        for (int i=0;i<numBrainShapes();i++) {
+            if (!pickShape(shape, i)) continue;
+            runBirths(births, seed);
+        }
+        return 0;
+    }
+
+    for (int level=SIMD_SSE2;level<=simdSupported();level++) {
+        if (strcmp(simd, "all")==0) setSimdLevel(level);
+        else if (level!=simdLevel()) continue;
+        for (int k=0;k<SIGMOID_KINDS;k++) {
+            if (strcmp(sigmoid, "all")!=0 && sigmoidByName(sigmoid)!=k) continue;
+            static const int BITS[]= {32, 16, 8};
+            for (int w=0;w<3;w++) {
+                if (strcmp(weights, "all")!=0 && strcmp(weights, weightsName(BITS[w]))!=0) continue;
+                BrainArena::setWeightBits(BITS[w]);
+                for (int p=1;p>=0;p--) {
+                    if (strcmp(prune, "both")!=0 && strcmp(prune, p ? "on" : "off")!=0) continue;
+                    BrainArena::setPruning(p==1);
+                    for (int i=0;i<numBrainShapes();i++) {
+                        if (!pickShape(shape, i)) continue;
+                        for (int j=1;j>=0;j--) {
+                            if (strcmp(jit, "both")!=0 && strcmp(jit, j ? "on" : "off")!=0) continue;
+                            AsmJit::setEnabled(j==1);
+                            for (int n=0;n<=1;n++) {
+                                if (strcmp(native, "both")!=0 && strcmp(native, n ? "on" : "off")!=0) continue;
+                                MLPNative::setEnabled(n==1);
+                                if (strcmp(huge, "off")==0 || strcmp(huge, "both")==0) runEvery(every, ticks, numagents, seed, false, k);
+                                if (strcmp(huge, "on")==0 || strcmp(huge, "both")==0) runEvery(every, ticks, numagents, seed, true, k);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+Brain kernel benchmark. Builds a population of random brains of each type,
+without a World, and times ticking it, mutating it and crossing it over,
+from a fixed seed. Prints one line of key=value pairs per brain type,
+population size and thread count, so results are easy to collect from
+scripts and to compare between brain types and builds.
+
+    sbbrains [-brain mlp|dwraon|assembly|dense|all] [-agents N[,N...]]
+             [-threads N[,N...]] [-ticks N] [-ops N] [-seed N]
+             [-mutrate F] [-mutrate2 F]
+
+The population is ticked the way the World ticks it: MLP brains in a
+BrainArena, dense brains with DenseBrain::tickAll, the others one by one,
+all on -threads threads. The inputs cycle through a few random frames per
+brain, as an agent's senses change. tick_ns= is per brain tick. Mutation
+and crossover run on one thread, as births do in the World: -ops of each,
+spread over the population, at the -mutrate and -mutrate2 of an agent.
+mutate_ns= and crossover_ns= are per call, mutations= the sites changed
+per call on average. checksum= sums the outputs of the last tick, so two
+builds that compute the same print the same checksum for a seed.
+The MLP shape, sigmoid, SIMD level, pruning, weights and JITs are the
+defaults (see sbbench to vary them).
+*/
+
+#include "AgentBrain.h"
+#include "BrainArena.h"
+#include "Simd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+const int FRAMES= 8; //input frames per brain
+
+//a population of brains of one type, ticked the way World::brainsTick does
+struct Population {
+    int type;
+    std::vector<AgentBrain> brains;
+    std::vector< std::vector<float> > in, out;
+    std::vector< std::vector<float> > frames; //FRAMES per brain
+    BrainArena arena;
+    std::vector<int> slots;
+
+    Population(int type, int n) :
+            type(type),
+            in(n, std::vector<float>(INPUTSIZE)),
+            out(n, std::vector<float>(OUTPUTSIZE, 0)),
+            frames(n*FRAMES, std::vector<float>(INPUTSIZE))
+    {
+        brains.reserve(n);
+        for (int k=0;k<n;k++) brains.push_back(AgentBrain(type));
+        for (int k=0;k<n*FRAMES;k++) {
+            for (int i=0;i<INPUTSIZE;i++) frames[k][i]= randf(0,1);
+        }
+        if (type!=AgentBrain::MLP) return;
+        for (int k=0;k<n;k++) {
+            slots.push_back(arena.alloc());
+            arena.load(slots[k], brains[k].mlp());
+        }
+    }
+
+    void tick(int t)
+    {
+        int n= brains.size();
+        for (int k=0;k<n;k++) in[k]= frames[k*FRAMES + t%FRAMES];
+
+        if (type==AgentBrain::MLP) {
+            std::vector< std::vector<float>* > ins(arena.capacity(), (std::vector<float>*) NULL);
+            std::vector< std::vector<float>* > outs(arena.capacity(), (std::vector<float>*) NULL);
+            for (int k=0;k<n;k++) {
+                ins[slots[k]]= &in[k];
+                outs[slots[k]]= &out[k];
+            }
+            arena.tickAll(&ins[0], &outs[0]);
+        } else if (type==AgentBrain::DENSE) {
+            std::vector<DenseBrain*> b(n);
+            std::vector< std::vector<float>* > ins(n), outs(n);
+            for (int k=0;k<n;k++) {
+                b[k]= &brains[k].dense();
+                ins[k]= &in[k];
+                outs[k]= &out[k];
+            }
+            DenseBrain::tickAll(&b[0], &ins[0], &outs[0], n);
+        } else {
+            #pragma omp parallel for
+            for (int k=0;k<n;k++) brains[k].tick(in[k], out[k]);
+        }
+    }
+
+    double checksum() const
+    {
+        double sum= 0;
+        for (size_t k=0;k<out.size();k++) {
+            for (int i=0;i<OUTPUTSIZE;i++) sum+= out[k][i]*(i+1);
+        }
+        return sum;
+    }
+};
+
+static double since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+static void run(int type, int agents, int threads, int ticks, int ops, int seed, float MR, float MR2)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#else
+    threads= 1;
+#endif
+    srand(seed);
+    Population pop(type, agents);
+
+    pop.tick(0); //first touch, and the MLP blocks get built
+    std::chrono::steady_clock::time_point t0= std::chrono::steady_clock::now();
+    for (int t=1;t<=ticks;t++) pop.tick(t);
+    double ticksecs= since(t0);
+    double sum= pop.checksum();
+
+    //on copies, so each op starts from the population as it was built
+    srand(seed+1);
+    std::vector<AgentBrain> copies(pop.brains);
+    long mutations= 0;
+    t0= std::chrono::steady_clock::now();
+    for (int k=0;k<ops;k++) {
+        MutationLog log;
+        copies[k%agents].mutate(MR, MR2, &log);
+        mutations+= log.total();
+    }
+    double mutsecs= since(t0);
+
+    t0= std::chrono::steady_clock::now();
+    for (int k=0;k<ops;k++) {
+        AgentBrain child= pop.brains[k%agents].crossover(pop.brains[(k+1)%agents]);
+    }
+    double crosssecs= since(t0);
+
+    printf("brain=%s agents=%i threads=%i simd=%s ticks=%i seed=%i tick_seconds=%.3f brain_ticks_per_sec=%.1f tick_ns=%.1f ops=%i mutrate=%.4f mutrate2=%.4f mutations=%.2f mutate_ns=%.1f crossover_ns=%.1f checksum=%.6f\n",
+           AgentBrain::typeName(type), agents, threads, simdName(simdLevel()), ticks, seed, ticksecs,
+           (double) agents*ticks/ticksecs, ticksecs*1e9/((double) agents*ticks),
+           ops, MR, MR2, (double) mutations/ops, mutsecs*1e9/ops, crosssecs*1e9/ops, sum);
+    fflush(stdout);
+}
+
+//comma separated positive numbers into v. False if there are none or one is not
+static bool parseList(const char* s, std::vector<int>& v)
+{
+    v.clear();
+    while (*s) {
+        char* end;
+        long x= strtol(s, &end, 10);
+        if (end==s || x<=0) return false;
+        v.push_back((int) x);
+        s= end;
+        if (*s==',') s++;
+    }
+    return !v.empty();
+}
+
+int main(int argc, char **argv)
+{
+    const char* brain= "all";
+    std::vector<int> agents(1, 1000);
+    std::vector<int> threads(1, 1);
+#ifdef _OPENMP
+    threads[0]= omp_get_max_threads();
+#endif
+    int ticks= 200;
+    int ops= 20000;
+    int seed= 1;
+    float MR= 0.003, MR2= 0.05; //the middle of an agent's range
+
+    bool ok= true;
+    for (int i=1;i<argc && ok;i++) {
+        if (i+1<argc && strcmp(argv[i], "-brain")==0) brain= argv[++i];
+        else if (i+1<argc && strcmp(argv[i], "-agents")==0) ok= parseList(argv[++i], agents);
+        else if (i+1<argc && strcmp(argv[i], "-threads")==0) ok= parseList(argv[++i], threads);
+        else if (i+1<argc && strcmp(argv[i], "-ticks")==0) ticks= atoi(argv[++i]);
+        else if (i+1<argc && strcmp(argv[i], "-ops")==0) ops= atoi(argv[++i]);
+        else if (i+1<argc && strcmp(argv[i], "-seed")==0) seed= atoi(argv[++i]);
+        else if (i+1<argc && strcmp(argv[i], "-mutrate")==0) MR= atof(argv[++i]);
+        else if (i+1<argc && strcmp(argv[i], "-mutrate2")==0) MR2= atof(argv[++i]);
+        else ok= false;
+    }
+    bool all= strcmp(brain, "all")==0;
+    int only= AgentBrain::typeByName(brain);
+    if (!ok || ticks<=0 || ops<=0 || (!all && (only==-2 || only==AgentBrain::MIXED))) {
+        printf("usage: %s [-brain mlp|dwraon|assembly|dense|all] [-agents N[,N...]] [-threads N[,N...]] [-ticks N] [-ops N] [-seed N] [-mutrate F] [-mutrate2 F]\n", argv[0]);
+        return 1;
+    }
+
+    for (int t=0;t<AgentBrain::TYPES;t++) {
+        if (!all && only!=t) continue;
+        for (size_t a=0;a<agents.size();a++) {
+            for (size_t h=0;h<threads.size();h++) run(t, agents[a], threads[h], ticks, ops, seed, MR, MR2);
+        }
+    }
+    return 0;
+}
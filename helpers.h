@@ -2,12 +2,46 @@
 #define HELPERS_H
 #include <stdlib.h>
 #include <math.h>
+#include <limits.h>
 //uniform random in [a,b)
 inline float randf(float a, float b){return ((b-a)*((float)rand()/RAND_MAX))+a;}
 
 //uniform random int in [a,b)
 inline int randi(int a, int b){return (rand()%(b-a))+a;}
 
+//number of sites to pass over before the next one that mutates, when each
+//mutates with probability p on its own (geometric distribution). Walking a
+//genome with it costs a rand() per mutation rather than one per site. Capped
+//at INT_MAX/2, so a site index plus it does not overflow
+inline int randskip(float p){
+	if (p<=0) return INT_MAX/2;
+	if (p>=1) return 0;
+	double u= (rand()+1.0)/(RAND_MAX+2.0); //in (0,1)
+	double k= floor(log(u)/log1p(-(double) p));
+	return k<INT_MAX/2 ? (int) k : INT_MAX/2;
+}
+
+//fair coin flips, drawn 64 at a time, for choosing one of two parents per
+//gene without a rand() for each. Works for any RAND_MAX of at least 15 bits
+class RandBits {
+public:
+	RandBits() : bits(0), left(0) {}
+	bool next(){
+		if (left==0) {
+			bits= 0;
+			for (int i=0;i<5;i++) bits= (bits<<15) ^ (unsigned long long) (rand()&0x7fff);
+			left= 64;
+		}
+		bool b= bits&1;
+		bits>>= 1;
+		left--;
+		return b;
+	}
+private:
+	unsigned long long bits;
+	int left;
+};
+
 //normalvariate random N(mu, sigma)
 inline double randn(double mu, double sigma) {
 	static bool deviateAvailable=false;	//	flag
@@ -30,6 +64,14 @@ inline double randn(double mu, double sigma) {
 	}
 }
 
+//bytes malloc really takes for a block of the given size. This is how glibc
+//does it on 64 bit: 8 byte header, 16 byte granularity, 32 bytes at least
+inline size_t heapChunk(size_t bytes){
+	if (bytes==0) return 0;
+	size_t c= (bytes+8+15) & ~((size_t) 15);
+	return c<32 ? 32 : c;
+}
+
 //cap value between 0 and 1
 inline float cap(float a){ 
 	if (a<0) return 0;
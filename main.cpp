@@ -1,5 +1,9 @@
 #include "GLView.h"
 #include "World.h"
+#include "Sigmoid.h"
+#include "Simd.h"
+#include "MLPNative.h"
+#include "BrainShapes.h"
 
 #include "config.h"
 #ifdef LOCAL_GLUT32
@@ -9,16 +13,53 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 
 
 GLView* GLVIEW = new GLView(0);
 int main(int argc, char **argv) {
     srand(time(0));
+    for (int i=1;i<argc;i++) {
+        if (strcmp(argv[i], "-hugepages")==0) setHugePages(true); //back big arrays with huge pages
+        if (i+1<argc && strcmp(argv[i], "-sigmoid")==0) {
+            int k= sigmoidByName(argv[++i]);
+            if (k==-1) printf("unknown sigmoid %s, using exact\n", argv[i]);
+            else setSigmoid(k);
+        }
+        if (i+1<argc && strcmp(argv[i], "-brain")==0) {
+            int t= AgentBrain::typeByName(argv[++i]);
+            if (t==-2) printf("unknown brain type %s, using mlp\n", argv[i]);
+            else AgentBrain::setDefaultType(t);
+        }
+        if (i+1<argc && strcmp(argv[i], "-jit")==0) AsmJit::setEnabled(strcmp(argv[++i], "off")!=0); //native code for assembly brains
+        if (i+1<argc && strcmp(argv[i], "-prune")==0) BrainArena::setPruning(strcmp(argv[++i], "on")==0); //skip MLP boxes that can't reach the outputs
+        if (i+1<argc && strcmp(argv[i], "-weights")==0) {
+            const char* w= argv[++i];
+            if (strcmp(w, "int16")==0) BrainArena::setWeightBits(16);
+            else if (strcmp(w, "int8")==0) BrainArena::setWeightBits(8);
+            else if (strcmp(w, "float")!=0) printf("unknown weights %s, using float\n", w);
+        }
+        if (i+1<argc && strcmp(argv[i], "-brainevery")==0) World::setBrainEvery(atoi(argv[++i])); //tick brains every k-th tick only
+        if (i+1<argc && strcmp(argv[i], "-native")==0) MLPNative::setEnabled(strcmp(argv[++i], "on")==0); //compile long-lived MLP genomes
+        if (i+1<argc && strcmp(argv[i], "-simd")==0) {
+            int s= simdByName(argv[++i]);
+            if (s==-1) printf("unknown simd level %s\n", argv[i]);
+            else setSimdLevel(s); //never above what the CPU has
+        }
+        if (i+1<argc && strcmp(argv[i], "-shape")==0) {
+            int s= brainShapeByName(argv[++i]);
+            if (s==-1) printf("unknown brain shape %s, using %s\n", argv[i], brainShapeAt(0).name);
+            else MLPBrain::setShape(s); //no brains exist yet
+        }
+    }
+    printf("MLP brain shape: %s\n", brainShapeAt(MLPBrain::shape()).name);
+    printf("SIMD kernels: %s (CPU has %s)\n", simdName(simdLevel()), simdName(simdSupported()));
     if (conf::WIDTH%conf::CZ!=0 || conf::HEIGHT%conf::CZ!=0) printf("CAREFUL! The cell size variable conf::CZ should divide evenly into  both conf::WIDTH and conf::HEIGHT! It doesn't right now!");
     
     
     printf("p= pause, d= toggle drawing (for faster computation), f= draw food too, += faster, -= slower\n");
     printf("Pan around by holding down right mouse button, and zoom by holding down middle button.\n");
+    printf("m= print memory used per agent\n");
     
     World* world = new World();
     GLVIEW->setWorld(world);
@@ -3,6 +3,7 @@
 #define NUMEYES 4
 #define BRAINSIZE 200
 #define CONNS 4
+#define DENSEHIDDEN 64
 
 #ifndef SETTINGS_H
 #define SETTINGS_H
@@ -29,6 +30,8 @@ namespace conf {
     const float DIST= 150;		//how far can the eyes see on each bot?
     const float METAMUTRATE1= 0.002; //what is the change in MUTRATE1 and 2 on reproduction? lol
     const float METAMUTRATE2= 0.05;
+    const bool MUTATIONLOG= false; //append binary mutation records of every newborn to mutations.dat?
+    const int MLPNATIVETICKS= 1000; //ticks an MLP genome runs before it is compiled to native code, if that is on
 
     const float FOODINTAKE= 0.002; //how much does every agent consume?
     const float FOODWASTE= 0.001; //how much food disapears if agent eats?